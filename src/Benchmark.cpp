@@ -0,0 +1,240 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <stdio.h>
+#include <map>
+#include <sstream>
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "ElasticTabstops.h"
+#include "ScintillaEditor.h"
+
+// How much a deterministic metric may grow before it is reported as a regression
+#define BENCHMARK_TOLERANCE 0.05
+
+// The view is this many lines tall whatever the size of the window, otherwise the counts only
+// match a baseline recorded with the same window
+#define BENCHMARK_LINES_ON_SCREEN 50
+
+struct bm_metric {
+	std::string name;
+	double value;
+	bool deterministic; // Wall-clock times are reported but never compared
+};
+
+static ScintillaEditor editor;
+static SciFnDirect sci_direct_function;
+static const Configuration *bm_config;
+static std::vector<bm_metric> metrics;
+static LARGE_INTEGER start_time;
+
+static sptr_t fixed_view_direct_function(sptr_t ptr, unsigned int message, uptr_t wParam, sptr_t lParam) {
+	if (message == SCI_LINESONSCREEN) return BENCHMARK_LINES_ON_SCREEN;
+	return sci_direct_function(ptr, message, wParam, lParam);
+}
+
+static const CorpusParams *find_preset(const char *name) {
+	for (size_t i = 0; i < CorpusPresetCount; ++i) {
+		if (strcmp(CorpusPresets[i].name, name) == 0) return &CorpusPresets[i];
+	}
+	return nullptr;
+}
+
+static void load(const char *preset) {
+	editor.SetText(CorpusGenerate(find_preset(preset)));
+	editor.EmptyUndoBuffer();
+	editor.SetFirstVisibleLine(0);
+	ElasticTabstopsSwitchToEditor(editor, bm_config);
+}
+
+static void begin() {
+	ElasticTabstopsResetCounters();
+	QueryPerformanceCounter(&start_time);
+}
+
+// For scenarios the engine's counters don't cover
+static void end_timed(const char *scenario) {
+	LARGE_INTEGER end_time, frequency;
+	QueryPerformanceCounter(&end_time);
+	QueryPerformanceFrequency(&frequency);
+
+	metrics.push_back({ std::string(scenario) + ".ms", (end_time.QuadPart - start_time.QuadPart) * 1000.0 / frequency.QuadPart, false });
+}
+
+static void end(const char *scenario) {
+	const ElasticTabstopsCounters *counters = ElasticTabstopsGetCounters();
+	const std::string prefix = std::string(scenario) + ".";
+
+	metrics.push_back({ prefix + "lines_measured", (double)counters->lines_measured, true });
+	metrics.push_back({ prefix + "cells_measured", (double)counters->cells_measured, true });
+	metrics.push_back({ prefix + "text_width_calls", (double)counters->text_width_calls, true });
+	metrics.push_back({ prefix + "tabstops_set", (double)counters->tabstops_set, true });
+	end_timed(scenario);
+}
+
+static void scenario_open_view() {
+	load("tables");
+	begin();
+	ElasticTabstopsComputeCurrentView();
+	end("open_view");
+}
+
+static void scenario_scroll() {
+	load("tables");
+	ElasticTabstopsComputeCurrentView();
+
+	begin();
+	const int lines_on_screen = editor.LinesOnScreen();
+	for (int page = 1; page <= 200; ++page) {
+		editor.SetFirstVisibleLine(page * lines_on_screen);
+		ElasticTabstopsOnScroll();
+	}
+	end("scroll");
+}
+
+static void scenario_type_tall_block() {
+	load("giant_block");
+	const int line = editor.GetLineCount() / 2;
+	editor.SetFirstVisibleLine(line - editor.LinesOnScreen() / 2);
+	ElasticTabstopsComputeCurrentView();
+
+	begin();
+	int pos = editor.PositionFromLine(line);
+	for (int i = 0; i < 100; ++i, ++pos) {
+		editor.InsertText(pos, "x");
+		ElasticTabstopsOnModify(pos, pos + 1, 0, false);
+	}
+	end("type_tall_block");
+}
+
+static void scenario_paste_block() {
+	CorpusParams params = *find_preset("giant_block");
+	params.lines = 1000;
+	const std::string block = CorpusGenerate(&params);
+
+	load("tables");
+	const int line = editor.GetLineCount() / 2;
+	editor.SetFirstVisibleLine(line - editor.LinesOnScreen() / 2);
+	ElasticTabstopsComputeCurrentView();
+
+	begin();
+	const int pos = editor.PositionFromLine(line);
+	editor.InsertText(pos, block);
+	ElasticTabstopsOnModify(pos, pos + (int)block.size(), (int)params.lines, true);
+	end("paste_block");
+}
+
+static size_t count_changed_lines(const std::string &before, const std::string &after) {
+	std::istringstream before_lines(before), after_lines(after);
+	std::string before_line, after_line;
+	size_t changed = 0;
+
+	while (true) {
+		const bool has_before = (bool)std::getline(before_lines, before_line);
+		const bool has_after = (bool)std::getline(after_lines, after_line);
+		if (!has_before && !has_after) break;
+		if (has_before != has_after || before_line != after_line) changed++;
+	}
+
+	return changed;
+}
+
+static void scenario_convert() {
+	load("tables");
+	begin();
+	ElasticTabstopsConvertToSpaces(bm_config);
+	end("convert");
+
+	// Converting back to tabs only scans the text so there is nothing to count, other than the lines
+	// that don't lay out the same once converted to spaces again. A block with an empty cell can look
+	// like a single space between two words, so that isn't always none.
+	const std::string spaces = editor.GetText();
+	begin();
+	ElasticTabstopsConvertToTabs();
+	end_timed("convert_to_tabs");
+	ElasticTabstopsConvertToSpaces(bm_config);
+
+	metrics.push_back({ "convert_to_tabs.lines_changed", (double)count_changed_lines(spaces, editor.GetText()), true });
+}
+
+static void write_results(const std::wstring &path) {
+	FILE *file = _wfopen(path.c_str(), L"w");
+	if (file == nullptr) return;
+
+	fputs("{\n", file);
+	for (size_t i = 0; i < metrics.size(); ++i) {
+		fprintf(file, "\t\"%s\": %.3f%s\n", metrics[i].name.c_str(), metrics[i].value, i + 1 < metrics.size() ? "," : "");
+	}
+	fputs("}\n", file);
+
+	fclose(file);
+}
+
+static void read_baseline(const std::string &json, std::map<std::string, double> &baseline) {
+	// Only needs to understand the flat object written by write_results(), one metric per line
+	std::istringstream lines(json);
+	std::string line;
+	char name[256];
+	double value;
+	while (std::getline(lines, line)) {
+		if (sscanf(line.c_str(), " \"%255[^\"]\": %lf", name, &value) == 2) {
+			baseline[name] = value;
+		}
+	}
+}
+
+std::string BenchmarkRun(HWND sci, const Configuration *config, const std::wstring &resultsPath, const std::string &baseline, bool *passed) {
+	sci_direct_function = (SciFnDirect)SendMessage(sci, SCI_GETDIRECTFUNCTION, 0, 0);
+	editor = ScintillaEditor(fixed_view_direct_function, SendMessage(sci, SCI_GETDIRECTPOINTER, 0, 0));
+	bm_config = config;
+	metrics.clear();
+	ElasticTabstopsSetSeparator('\t', false);
+
+	scenario_open_view();
+	scenario_scroll();
+	scenario_type_tall_block();
+	scenario_paste_block();
+	scenario_convert();
+
+	write_results(resultsPath);
+
+	std::map<std::string, double> baseline_metrics;
+	read_baseline(baseline, baseline_metrics);
+
+	std::string report;
+	int regressions = 0;
+	for (const auto &metric : metrics) {
+		if (!metric.deterministic) continue;
+
+		auto it = baseline_metrics.find(metric.name);
+		if (it == baseline_metrics.end()) {
+			report += "FAILED " + metric.name + " is not in the baseline\n";
+		}
+		else if (metric.value > it->second * (1.0 + BENCHMARK_TOLERANCE)) {
+			report += "REGRESSION " + metric.name + ": " + std::to_string((long long)it->second) + " -> " + std::to_string((long long)metric.value) + "\n";
+			regressions++;
+		}
+	}
+
+	*passed = report.empty();
+	if (regressions > 0) {
+		report = "FAILED " + std::to_string(regressions) + " metrics grew more than " + std::to_string((int)(BENCHMARK_TOLERANCE * 100)) + "% over the baseline\n" + report;
+	}
+
+	return *passed ? "All metrics are within tolerance of the baseline." : report;
+}
@@ -0,0 +1,27 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include "PluginInterface.h"
+#include "Config.h"
+
+// Runs every scenario in the given (scratch) editor and writes the results to resultsPath as JSON.
+// The deterministic metrics are compared against baseline, the JSON of an earlier run. Returns a
+// readable report, passed is false if anything failed or grew past the tolerance.
+std::string BenchmarkRun(HWND sci, const Configuration *config, const std::wstring &resultsPath, const std::string &baseline, bool *passed);
@@ -43,6 +43,42 @@ static std::vector<std::string> split(std::string const &str, const char delim)
 	return out;
 }
 
+static size_t parse_size(const char *c) {
+	while (isspace(*c)) c++;
+	return strtoul(c, nullptr, 10);
+}
+
+static std::wstring s2ws(const std::string &str) {
+	std::wstring wstr(str.size(), 0);
+	wstr.resize(MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), &wstr[0], (int)wstr.size()));
+	return wstr;
+}
+
+static void ConfigCompile(Configuration *config) {
+	config->extension_verdicts.clear();
+	config->extension_separators.clear();
+	config->default_verdict = false;
+
+	// The first matching extension wins, so anything after a wildcard can never match
+	for (const auto &extension : config->file_extensions) {
+		if (extension == "*" || extension == "!*") {
+			config->default_verdict = extension == "*";
+			break;
+		}
+
+		bool not = extension[0] == '!';
+		config->extension_verdicts.emplace(s2ws(extension.substr(not ? 1 : 0)), !not);
+	}
+
+	for (const auto &separator : config->separators) {
+		// Each one is in the form of "extension:separator"
+		size_t colon = separator.rfind(':');
+		if (colon != std::string::npos && colon + 2 == separator.size()) {
+			config->extension_separators.emplace(s2ws(separator.substr(0, colon)), separator[colon + 1]);
+		}
+	}
+}
+
 const wchar_t *GetIniFilePath(const NppData *nppData) {
 	static wchar_t iniPath[MAX_PATH];
 	SendMessage(nppData->_nppHandle, NPPM_GETPLUGINSCONFIGDIR, MAX_PATH, (LPARAM)iniPath);
@@ -50,12 +86,21 @@ const wchar_t *GetIniFilePath(const NppData *nppData) {
 	return iniPath;
 }
 
+std::wstring GetConfigFilePath(const NppData *nppData, const wchar_t *fileName) {
+	wchar_t configDir[MAX_PATH];
+	SendMessage(nppData->_nppHandle, NPPM_GETPLUGINSCONFIGDIR, MAX_PATH, (LPARAM)configDir);
+	return std::wstring(configDir) + L"\\" + fileName;
+}
+
 void ConfigLoad(const NppData *nppData, Configuration *config) {
 	const wchar_t *iniPath = GetIniFilePath(nppData);
 
 	FILE *file = _wfopen(iniPath, L"r");
 
-	if (file == nullptr) return;
+	if (file == nullptr) {
+		ConfigCompile(config);
+		return;
+	}
 
 	char line[256];
 	while (true) {
@@ -96,9 +141,47 @@ void ConfigLoad(const NppData *nppData, Configuration *config) {
 			while (isspace(*c)) c++;
 			config->convert_leading_tabs_to_spaces = strncmp(c, "true", 4) == 0;
 		}
+		else if (strncmp(line, "separators ", 11) == 0) {
+			// Strip the newline
+			line[strcspn(line, "\r\n")] = 0;
+
+			config->separators = split(&line[11], ' ');
+		}
+		else if (strncmp(line, "quoted_separators ", 18) == 0) {
+			char *c = &line[18];
+			while (isspace(*c)) c++;
+			config->quoted_separators = strncmp(c, "true", 4) == 0;
+		}
+		else if (strncmp(line, "trace ", 6) == 0) {
+			char *c = &line[6];
+			while (isspace(*c)) c++;
+			config->trace = strncmp(c, "true", 4) == 0;
+		}
+		else if (strncmp(line, "record ", 7) == 0) {
+			char *c = &line[7];
+			while (isspace(*c)) c++;
+			config->record = strncmp(c, "true", 4) == 0;
+		}
+		else if (strncmp(line, "max_document_size ", 18) == 0) {
+			config->max_document_size = parse_size(&line[18]);
+		}
+		else if (strncmp(line, "max_line_length ", 16) == 0) {
+			config->max_line_length = parse_size(&line[16]);
+		}
+		else if (strncmp(line, "max_cells_per_line ", 19) == 0) {
+			config->max_cells_per_line = parse_size(&line[19]);
+		}
+		else if (strncmp(line, "max_block_height ", 17) == 0) {
+			config->max_block_height = parse_size(&line[17]);
+		}
+		else if (strncmp(line, "layout_snapshot_size ", 21) == 0) {
+			config->layout_snapshot_size = parse_size(&line[21]);
+		}
 	}
 
 	fclose(file);
+
+	ConfigCompile(config);
 }
 
 void ConfigSave(const NppData *nppData, const Configuration *config) {
@@ -129,7 +212,41 @@ void ConfigSave(const NppData *nppData, const Configuration *config) {
 
 	// Leading tabs
 	fputs("; Convert leading tabs to spaces: true or false\n", file);
-	fprintf(file, "convert_leading_tabs_to_spaces %s\n", config->convert_leading_tabs_to_spaces == true ? "true" : "false");
+	fprintf(file, "convert_leading_tabs_to_spaces %s\n\n", config->convert_leading_tabs_to_spaces == true ? "true" : "false");
+
+	// Separators
+	fputs("; Cell separators other than tabs for file extensions, as extension:separator. For example...\n", file);
+	fputs(";   \"separators .csv:, .psv:|\" splits cells on commas in CSV files and on pipes in PSV files\n", file);
+	fputs("; Only tabs can be aligned on screen, these files are aligned by converting to spaces, which pads the cell after each separator\n", file);
+	fprintf(file, "separators %s\n\n", join(config->separators, ' ').c_str());
+
+	fputs("; Ignore separators inside double quotes: true or false\n", file);
+	fprintf(file, "quoted_separators %s\n\n", config->quoted_separators == true ? "true" : "false");
+
+	// Large file limits
+	fputs("; Limits for large files. Past these the plugin switches to a cheaper mode instead of freezing. 0 means no limit\n", file);
+	fputs(";   max_document_size in bytes, only the visible lines are computed\n", file);
+	fputs(";   max_line_length in bytes, elastic tabstops are disabled for the file\n", file);
+	fputs(";   max_cells_per_line, widths are estimated as if the font was monospaced\n", file);
+	fputs(";   max_block_height in lines, how far converting a selection looks for the rest of its column blocks\n", file);
+	fprintf(file, "max_document_size %Iu\n", config->max_document_size);
+	fprintf(file, "max_line_length %Iu\n", config->max_line_length);
+	fprintf(file, "max_cells_per_line %Iu\n", config->max_cells_per_line);
+	fprintf(file, "max_block_height %Iu\n\n", config->max_block_height);
+
+	// Layout snapshots
+	fputs("; Keep the layout of files of at least this many bytes in the config directory, so reopening them doesn't measure anything. Only the last 16 are kept and any edit drops it. 0 disables it\n", file);
+	fprintf(file, "layout_snapshot_size %Iu\n\n", config->layout_snapshot_size);
+
+	// Tracing
+	fputs("; Record a trace of the notifications and where the time went to ElasticTabstopsTrace.json: true or false\n", file);
+	fputs("; The trace can be loaded in chrome://tracing or https://ui.perfetto.dev\n", file);
+	fprintf(file, "trace %s\n\n", config->trace == true ? "true" : "false");
+
+	// Recording
+	fputs("; Record the notifications and the documents they were for to ElasticTabstopsRecording.bin: true or false\n", file);
+	fputs("; The recording holds the full text of every document switched to, it can be replayed with a debug build\n", file);
+	fprintf(file, "record %s\n", config->record == true ? "true" : "false");
 
 	fclose(file);
 }
@@ -22,14 +22,35 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 typedef struct Configuration{
 	bool enabled;
 	std::vector<std::string> file_extensions;
 	size_t min_padding;
 	bool convert_leading_tabs_to_spaces;
+	std::vector<std::string> separators;
+	bool quoted_separators;
+
+	// Limits past which the engine degrades to a cheaper mode, 0 disables the limit
+	size_t max_document_size;
+	size_t max_line_length;
+	size_t max_cells_per_line;
+	size_t max_block_height;
+
+	// Documents of at least this many bytes keep their layout on disk between sessions, 0 disables it
+	size_t layout_snapshot_size;
+
+	bool trace;
+	bool record;
+
+	// Compiled from file_extensions and separators when loading so files can be looked up without any conversions
+	std::unordered_map<std::wstring, bool> extension_verdicts;
+	bool default_verdict;
+	std::unordered_map<std::wstring, char> extension_separators;
 }Configuration;
 
 const wchar_t *GetIniFilePath(const NppData *nppData);
+std::wstring GetConfigFilePath(const NppData *nppData, const wchar_t *fileName);
 void ConfigLoad(const NppData *nppData, Configuration *config);
 void ConfigSave(const NppData *nppData, const Configuration *config);
@@ -0,0 +1,114 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <random>
+#include "Corpus.h"
+
+const CorpusParams CorpusPresets[] = {
+	// name           seed   lines  columns block height  cell length  indent  non-ascii  shape
+	{ "tables",         1, 100000,     6,     2,    50,     0,   24,     3,      0, SHAPE_TABLES },
+	{ "unicode",        2, 100000,     6,     2,    50,     0,   24,     3,     30, SHAPE_TABLES },
+	{ "giant_block",    3, 100000,     4,     0,     0,     1,   16,     0,      0, SHAPE_GIANT_BLOCK },
+	{ "alternating",    4, 100000,     4,     0,     0,     1,   16,     0,      0, SHAPE_ALTERNATING },
+	{ "wide_lines",     5,    200, 10000,    10,    50,     0,    8,     0,      0, SHAPE_WIDE_LINES },
+};
+
+const size_t CorpusPresetCount = sizeof(CorpusPresets) / sizeof(CorpusPresets[0]);
+
+class CorpusGenerator {
+private:
+	const CorpusParams *params;
+	std::mt19937 rng;
+	std::string text;
+
+	size_t random(size_t min, size_t max) {
+		if (max <= min) return min;
+		// Not std::uniform_int_distribution, every standard library implements it differently
+		return min + rng() % (max - min + 1);
+	}
+
+	void append_cell_text() {
+		static const char *non_ascii[] = { "\xC3\xA9", "\xC3\xBC", "\xD0\xB6", "\xE4\xB8\xAD", "\xE2\x80\x94" };
+		size_t length = random(params->min_cell_length, params->max_cell_length);
+
+		for (size_t i = 0; i < length; ++i) {
+			if (params->non_ascii_percent > 0 && (int)random(1, 100) <= params->non_ascii_percent) {
+				text += non_ascii[random(0, sizeof(non_ascii) / sizeof(non_ascii[0]) - 1)];
+			}
+			else {
+				text += (char)('a' + random(0, 25));
+			}
+		}
+	}
+
+	void append_table_line(size_t indent) {
+		text.append(indent, '\t');
+		for (size_t c = 0; c < params->columns; ++c) {
+			append_cell_text();
+			text += '\t';
+		}
+		append_cell_text();
+		text += "\r\n";
+	}
+
+	void append_plain_line() {
+		append_cell_text();
+		text += "\r\n";
+	}
+
+public:
+	explicit CorpusGenerator(const CorpusParams *params) : params(params), rng(params->seed) {}
+
+	std::string generate() {
+		size_t line = 0;
+
+		while (line < params->lines) {
+			switch (params->shape) {
+				case SHAPE_GIANT_BLOCK:
+					append_table_line(0);
+					line++;
+					break;
+				case SHAPE_ALTERNATING:
+					if (line % 2 == 0) append_table_line(0);
+					else append_plain_line();
+					line++;
+					break;
+				case SHAPE_TABLES:
+				case SHAPE_WIDE_LINES: {
+					// The indentation stays the same within a block like it would in code
+					size_t height = random(params->min_block_height, params->max_block_height);
+					size_t indent = random(0, params->max_indent);
+					for (size_t i = 0; i < height && line < params->lines; ++i, ++line) {
+						append_table_line(indent);
+					}
+					if (line < params->lines) {
+						append_plain_line();
+						line++;
+					}
+					break;
+				}
+			}
+		}
+
+		return std::move(text);
+	}
+};
+
+std::string CorpusGenerate(const CorpusParams *params) {
+	return CorpusGenerator(params).generate();
+}
@@ -0,0 +1,49 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+
+enum CorpusShape {
+	SHAPE_TABLES,       // Column blocks of random height separated by lines without tabs
+	SHAPE_GIANT_BLOCK,  // Every line is part of a single column block
+	SHAPE_ALTERNATING,  // Lines with and without tabs alternate, so every block is a single line
+	SHAPE_WIDE_LINES    // Same as tables, meant to be used with a very large number of columns
+};
+
+typedef struct CorpusParams {
+	const char *name;
+	unsigned int seed;
+	size_t lines;
+	size_t columns;
+	size_t min_block_height;
+	size_t max_block_height;
+	size_t min_cell_length;
+	size_t max_cell_length;
+	size_t max_indent;
+	int non_ascii_percent;
+	CorpusShape shape;
+}CorpusParams;
+
+// Documents the benchmarks are run against
+extern const CorpusParams CorpusPresets[];
+extern const size_t CorpusPresetCount;
+
+// Generates the same document for the same parameters
+std::string CorpusGenerate(const CorpusParams *params);
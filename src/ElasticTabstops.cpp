@@ -19,8 +19,17 @@
 
 #include <vector>
 #include <string>
+#include <thread>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
 #include "ElasticTabstops.h"
+#include "ElasticTabstopsMsgs.h"
 #include "ScintillaEditor.h"
+#include "Trace.h"
 
 #define MARK_UNDERLINE 20
 #define SC_MARGIN_SYBOL 1
@@ -30,10 +39,276 @@ static ScintillaEditor editor;
 static int tab_width_minimum;
 static int tab_width_padding;
 static int char_width;
-static int(*get_text_width)(int start, int end);
 
 static int startLine;
 static int endLine;
+static int firstVisibleLine; // When startLine and endLine were computed
+static int scroll_velocity; // Lines per scroll, smoothed out and negative when scrolling up
+
+// Scintilla only moves tab characters to tabstops, so files with any other separator aren't laid out on
+// screen. Their cells are only aligned by converting to spaces, which keeps the separator.
+static char separator = '\t';
+static bool quoted_separators;
+
+// Spaces can only stand in for whole characters, so converting counts them in the document's code page.
+// In DBCS code pages these bytes start a character that is two bytes long.
+static int code_page;
+static bool dbcs_lead_bytes[256];
+
+static size_t max_document_size;
+static size_t max_line_length;
+static size_t max_cells_per_line;
+static size_t max_block_height; // Only used to find blocks when converting, on screen they are cut off by the view
+
+// Cheaper modes the engine falls back to for large files, ordered from most to least expensive
+enum et_mode {
+	MODE_FULL,
+	MODE_VIEWPORT,
+	MODE_MONOSPACE,
+	MODE_DISABLED
+};
+
+static et_mode mode;
+static std::string mode_reason;
+
+static ElasticTabstopsCounters counters;
+
+// Half-open ranges of lines that have had tabstops set. This is allowed to be a superset
+// so it only ever has to grow when lines are inserted or deleted.
+class LineRanges {
+private:
+	std::map<int, int> ranges;
+
+public:
+	void add(int start, int end) {
+		auto it = ranges.upper_bound(start);
+		if (it != ranges.begin() && std::prev(it)->second >= start) {
+			--it;
+			start = it->first;
+			end = __max(end, it->second);
+			it = ranges.erase(it);
+		}
+		while (it != ranges.end() && it->first <= end) {
+			end = __max(end, it->second);
+			it = ranges.erase(it);
+		}
+		ranges.emplace(start, end);
+	}
+
+	void remove(int start, int end) {
+		auto it = ranges.upper_bound(start);
+		if (it != ranges.begin() && std::prev(it)->second > start) --it;
+
+		while (it != ranges.end() && it->first < end) {
+			const int range_start = it->first;
+			const int range_end = it->second;
+			it = ranges.erase(it);
+			if (range_start < start) ranges.emplace(range_start, start);
+			if (range_end > end) ranges.emplace(end, range_end);
+		}
+	}
+
+	// Lines after line have moved by delta
+	void shift(int line, int delta) {
+		std::map<int, int> old_ranges;
+		old_ranges.swap(ranges);
+
+		for (const auto &range : old_ranges) {
+			int start = range.first;
+			int end = range.second;
+			if (start > line) start = __max(line + 1, start + delta);
+			if (end > line) end = __max(line + 1, end + delta);
+			if (start < end) add(start, end);
+		}
+	}
+
+	template<typename F>
+	void for_each_line(F f) const {
+		for (const auto &range : ranges) {
+			for (int line = range.first; line < range.second; ++line) f(line);
+		}
+	}
+
+	template<typename F>
+	void for_each_range(F f) const {
+		for (const auto &range : ranges) f(range.first, range.second);
+	}
+
+	bool empty() const {
+		return ranges.empty();
+	}
+
+	void clear() {
+		ranges.clear();
+	}
+};
+
+// The tabstops that have been set on each line, so they never need to be read back from Scintilla and
+// lines whose tabstops didn't change can be left alone. Lines are inserted and removed the same way
+// Scintilla moves its own per line data: new lines start without tabstops and removed lines take
+// theirs with them.
+class LineTabstops {
+private:
+	std::vector<std::vector<int>> lines;
+
+public:
+	const std::vector<int> &get(int line) const {
+		static const std::vector<int> none;
+		return (size_t)line < lines.size() ? lines[line] : none;
+	}
+
+	void set(int line, std::vector<int> &&tabstops) {
+		if ((size_t)line >= lines.size()) lines.resize(line + 1);
+		lines[line] = std::move(tabstops);
+	}
+
+	// Lines after line have moved by delta
+	void shift(int line, int delta) {
+		if ((size_t)line + 1 >= lines.size()) return;
+
+		if (delta > 0) lines.insert(lines.begin() + line + 1, delta, std::vector<int>());
+		else lines.erase(lines.begin() + line + 1, lines.begin() + __min(line + 1 - delta, (int)lines.size()));
+	}
+
+	template<typename F>
+	void for_each_line(F f) const {
+		for (size_t line = 0; line < lines.size(); ++line) {
+			if (!lines[line].empty()) f((int)line);
+		}
+	}
+
+	void clear() {
+		lines.clear();
+	}
+};
+
+// Scintilla keeps tabstops with the document, so they are tracked per document
+static std::map<sptr_t, LineTabstops> document_tabstops;
+static LineTabstops *line_tabstops;
+
+// A layout saved by an earlier session, mapped straight from the file. It is only good until the
+// document is edited.
+struct et_snapshot_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t content_hash;
+
+	// What the widths were measured with
+	int32_t reference_width;
+	int32_t tab_width_minimum;
+	int32_t tab_width_padding;
+
+	// Followed by line_count + 1 offsets into the tabstops, then the tabstops themselves
+	uint32_t line_count;
+};
+
+#define SNAPSHOT_MAGIC 0x54534C45 // "ELST"
+#define SNAPSHOT_VERSION 1
+
+static const et_snapshot_header *snapshot;
+static HANDLE snapshot_mapping;
+
+static void release_snapshot() {
+	if (snapshot == nullptr) return;
+
+	UnmapViewOfFile(snapshot);
+	CloseHandle(snapshot_mapping);
+	snapshot = nullptr;
+	snapshot_mapping = nullptr;
+}
+
+// The tabstops a document had when the plugin was disabled. Enabling it again puts back the ones in
+// view instead of measuring them, unless the document was edited or its fonts changed in between.
+static sptr_t suspended_document;
+static LineTabstops suspended_tabstops;
+static int suspended_reference_width;
+static char suspended_separator;
+static bool suspended_quoted_separators;
+
+static void release_suspended() {
+	suspended_document = 0;
+	suspended_tabstops.clear();
+}
+
+// A document closed while it is still shown, it is forgotten once another one is
+static sptr_t closed_document;
+
+// Lines whose styles changed since they were measured, with proportional fonts so might their widths
+static LineRanges restyled_lines;
+
+// Lines that were inserted or deleted while batching, as the line they were after and how many
+#define MAX_BATCHED_LINE_CHANGES 64
+static std::vector<std::pair<int, int>> batched_line_changes;
+static bool batching;
+static bool batch_overflowed;
+
+// Once a batch overflows, the lines that might still have tabstops. Shifting these is cheap, it
+// doesn't depend on how long the document is.
+static LineRanges overflowed_lines;
+
+#ifdef DEBUG_TOOLS
+// Markers and annotations stay with the document they were added to, same as tabstops
+struct et_debug_marks {
+	std::vector<int> marker_handles;
+	LineRanges annotated_lines;
+};
+
+static std::map<sptr_t, et_debug_marks> document_debug_marks;
+static et_debug_marks *debug_marks;
+#endif
+
+static void clear_tabstops() {
+	release_snapshot();
+
+	line_tabstops->for_each_line([](int line) {
+		editor.ClearTabStops(line);
+	});
+	line_tabstops->clear();
+}
+
+// Only tells Scintilla about tabstops that changed. Scintilla can't remove a single tabstop so the
+// line is cleared unless the new tabstops just add to the end of the ones already there. A line that
+// isn't tracked yet is always cleared first, in case the model lost track of what's on it.
+static void set_tabstops(int line, std::vector<int> &&tabstops) {
+	const std::vector<int> &current = line_tabstops->get(line);
+	if (current == tabstops) return;
+
+	size_t first_new = 0;
+	if (!current.empty() && current.size() < tabstops.size() && std::equal(current.begin(), current.end(), tabstops.begin())) {
+		first_new = current.size();
+	}
+	else {
+		editor.ClearTabStops(line);
+	}
+
+	for (size_t t = first_new; t < tabstops.size(); t++) {
+		editor.AddTabStop(line, tabstops[t]);
+	}
+	counters.tabstops_set += tabstops.size() - first_new;
+
+	line_tabstops->set(line, std::move(tabstops));
+}
+
+// Document pointers can be reused once a document is closed, so make sure what's tracked for this
+// one is actually in it
+static bool tabstops_match_editor() {
+	int first = -1, last = -1;
+	line_tabstops->for_each_line([&](int line) {
+		if (first < 0) first = line;
+		last = line;
+	});
+
+	for (int line : { first, last }) {
+		if (line < 0) continue;
+		if (line >= editor.GetLineCount()) return false;
+
+		const std::vector<int> &tabstops = line_tabstops->get(line);
+		if (editor.GetNextTabStop(line, 0) != tabstops.front()) return false;
+		if (editor.GetNextTabStop(line, tabstops.back()) != 0) return false;
+	}
+
+	return true;
+}
 
 enum direction {
 	BACKWARDS,
@@ -51,32 +326,247 @@ static int get_line_end(int pos) {
 }
 
 static void clear_debug_marks() {
-#ifdef _DEBUG
-	// Clear all the debugging junk, this way it only shows updates when it is actually recomputed
-	editor.MarkerDeleteAll(MARK_UNDERLINE);
+#ifdef DEBUG_TOOLS
+	// Clear all the debugging junk, this way it only shows updates when it is actually recomputed.
+	// Only what was painted by the previous recompute is touched so this stays cheap on big files.
+	for (int handle : debug_marks->marker_handles) {
+		editor.MarkerDeleteHandle(handle);
+	}
+	debug_marks->marker_handles.clear();
+
+	const int length = editor.GetLength();
 	for (int i = 0; i < DBG_INDICATORS; ++i) {
 		editor.SetIndicatorCurrent(i);
-		editor.IndicatorClearRange(0, editor.GetTextLength());
+
+		// Indicators are stored as runs, so jumping from run to run only visits what was painted
+		for (int pos = 0, end; pos < length; pos = end) {
+			end = editor.IndicatorEnd(i, pos);
+			if (end <= pos) break;
+			if (editor.IndicatorValueAt(i, pos)) editor.IndicatorClearRange(pos, end - pos);
+		}
 	}
+
+	debug_marks->annotated_lines.for_each_line([](int line) {
+		editor.AnnotationSetText(line, nullptr);
+	});
+	debug_marks->annotated_lines.clear();
 #endif
 }
 
-static int get_text_width_prop(int start, int end) {
-	std::string s(end - start + 1, 0);
+// How the width of a cell's text is measured. Each policy is a separate instantiation of the measuring
+// loop, picked once per recompute, so the width calculation can be inlined into it.
+enum et_width_policy {
+	WIDTH_PROPORTIONAL,
+	WIDTH_TABLE,
+	WIDTH_MONOSPACE
+};
+
+static et_width_policy width_policy;
+
+// Widths that have already been measured. They only hold for the fonts they were measured with, so
+// there is a cache for each document at each zoom level.
+struct et_width_cache {
+	// Keyed by the style followed by the text
+	std::unordered_map<std::string, int> text_widths;
+
+	// Widths of the ASCII characters in each style, 0 if not measured yet
+	int char_widths[STYLE_MAX + 1][128];
+
+	// Width of the alphabet in the default style, to rescale widths from one zoom level to another
+	int reference_width;
+
+	// Font of each style the first time it was measured, empty if it hasn't been yet
+	std::string font_keys[STYLE_MAX + 1];
+};
+
+static std::map<std::pair<sptr_t, int>, std::unique_ptr<et_width_cache>> width_caches;
+static et_width_cache *width_cache;
+
+#define MAX_CACHED_TEXT_WIDTHS 65536
+#define MAX_WIDTH_CACHES 16
+#define WIDTH_CACHE_SAMPLES 8
+
+// Widths measured in this and earlier sessions. Unlike the width caches they are keyed by the font
+// rather than the style, since the styles mean something different for every language.
+struct et_font_metrics {
+	int char_widths[128];
+	std::unordered_map<std::string, int> text_widths;
+};
+
+static std::unordered_map<std::string, et_font_metrics> font_metrics;
+
+#define MAX_FONT_METRICS 256
+#define MAX_SAVED_TEXT_WIDTHS 4096
+#define FONT_METRICS_MAGIC 0x4D46544C // "LTFM"
+#define FONT_METRICS_VERSION 1
+
+// Every measurement goes through here so they can be counted
+static int measure_text(int style, const char *text) {
+	counters.text_width_calls++;
+	return editor.TextWidth(style, text);
+}
+
+// Everything that decides how wide a style's text is
+static std::string get_font_key(int style) {
+	std::string key = editor.StyleGetFont(style);
+	const int values[] = { editor.StyleGetSizeFractional(style), editor.StyleGetWeight(style), editor.StyleGetItalic(style), editor.StyleGetCharacterSet(style), editor.GetZoom(), editor.GetTechnology() };
+	for (int value : values) {
+		key += '|';
+		key += std::to_string(value);
+	}
+	return key;
+}
+
+// The first time a style is measured, brings in anything already known about its font. Returns true
+// if there was anything.
+static bool use_font_metrics(int style) {
+	std::string &font_key = width_cache->font_keys[style];
+	if (!font_key.empty()) return false;
+
+	font_key = get_font_key(style);
+	auto it = font_metrics.find(font_key);
+	if (it == font_metrics.end()) return false;
+
+	// Font files can be updated and the DPI changed, one measurement is enough to tell
+	const et_font_metrics &metrics = it->second;
+	const int *c = std::find_if(metrics.char_widths + ' ', metrics.char_widths + 128, [](int width) { return width != 0; });
+	if (c != metrics.char_widths + 128) {
+		const char text[2] = { (char)(c - metrics.char_widths), '\0' };
+		if (measure_text(style, text) != *c) {
+			font_metrics.erase(it);
+			return false;
+		}
+	}
+	else if (!metrics.text_widths.empty()) {
+		const auto &text_width = *metrics.text_widths.begin();
+		if (measure_text(style, text_width.first.c_str()) != text_width.second) {
+			font_metrics.erase(it);
+			return false;
+		}
+	}
+
+	int *char_widths = width_cache->char_widths[style];
+	for (int i = ' '; i < 128; i++) {
+		if (char_widths[i] == 0) char_widths[i] = metrics.char_widths[i];
+	}
+
+	for (const auto &text_width : metrics.text_widths) {
+		if (width_cache->text_widths.size() >= MAX_CACHED_TEXT_WIDTHS) break;
+		width_cache->text_widths.emplace(std::string(1, (char)style) + text_width.first, text_width.second);
+	}
+
+	return true;
+}
+
+// Keeps what a width cache measured so it outlives the cache
+static void remember_font_metrics(const et_width_cache &cache) {
+	for (int style = 0; style <= STYLE_MAX; style++) {
+		const std::string &font_key = cache.font_keys[style];
+		if (font_key.empty()) continue;
+		if (font_metrics.size() >= MAX_FONT_METRICS && font_metrics.count(font_key) == 0) continue;
+
+		et_font_metrics &metrics = font_metrics[font_key];
+		for (int c = ' '; c < 128; c++) {
+			if (cache.char_widths[style][c] != 0) metrics.char_widths[c] = cache.char_widths[style][c];
+		}
+	}
+
+	for (const auto &text_width : cache.text_widths) {
+		auto it = font_metrics.find(cache.font_keys[(unsigned char)text_width.first[0]]);
+		if (it == font_metrics.end() || it->second.text_widths.size() >= MAX_SAVED_TEXT_WIDTHS) continue;
+
+		it->second.text_widths.emplace(text_width.first.substr(1), text_width.second);
+	}
+}
+
+struct et_width_proportional {
+	static int width(int start, int end, const char *text) {
+		std::string key(1, (char)editor.GetStyleAt(start));
+		key.append(text, end - start);
+
+		std::unordered_map<std::string, int> &text_widths = width_cache->text_widths;
+		auto it = text_widths.find(key);
+		if (it != text_widths.end()) return it->second;
+
+		if (use_font_metrics((unsigned char)key[0])) {
+			it = text_widths.find(key);
+			if (it != text_widths.end()) return it->second;
+		}
+
+		if (text_widths.size() >= MAX_CACHED_TEXT_WIDTHS) text_widths.clear();
+
+		int width = measure_text((unsigned char)key[0], key.c_str() + 1);
+		text_widths.emplace(std::move(key), width);
+		return width;
+	}
+};
+
+// Without kerning text is exactly as wide as the sum of its characters, so ASCII text can be measured
+// from a table. Anything else is measured as a whole.
+struct et_width_table {
+	static int width(int start, int end, const char *text) {
+		const int style = editor.GetStyleAt(start);
+		if (style < 0 || style > STYLE_MAX) return et_width_proportional::width(start, end, text);
+
+		int *widths = width_cache->char_widths[style];
+		int width = 0;
+
+		for (int i = 0; i < end - start; ++i) {
+			unsigned char c = (unsigned char)text[i];
+			if (c < ' ' || c >= 128) return et_width_proportional::width(start, end, text);
+
+			if (widths[c] == 0 && (!use_font_metrics(style) || widths[c] == 0)) {
+				const char s[2] = { (char)c, '\0' };
+				widths[c] = measure_text(style, s);
+			}
+			width += widths[c];
+		}
+
+		return width;
+	}
+};
+
+struct et_width_monospace {
+	static int width(int start, int end, const char *text) {
+		return (end - start) * char_width;
+	}
+};
+
+static void degrade(et_mode new_mode, const std::string &reason) {
+	// Only ever switch to a cheaper mode, reset_mode goes back to the most expensive one
+	if (new_mode <= mode) return;
 
-	Sci_TextRange range;
-	range.chrg.cpMin = start;
-	range.chrg.cpMax = end;
-	range.lpstrText = &s[0];
-	editor.GetTextRange(&range);
+	mode = new_mode;
+	mode_reason = reason;
 
-	int style = editor.GetStyleAt(start);
+	if (mode == MODE_MONOSPACE) {
+		width_policy = WIDTH_MONOSPACE;
+	}
+	else if (mode == MODE_DISABLED) {
+		// Part of the view might already have been stretched
+		clear_tabstops();
+	}
+}
 
-	return editor.TextWidth(style, range.lpstrText);
+// The mode the size and separator of the document allow for, the other limits are only found out while measuring
+static et_mode get_document_mode() {
+	if (separator != '\t') return MODE_DISABLED;
+	return max_document_size > 0 && (size_t)editor.GetLength() > max_document_size ? MODE_VIEWPORT : MODE_FULL;
 }
 
-static int get_text_width_mono(int start, int end) {
-	return (end - start) * char_width;
+static void reset_mode() {
+	mode = MODE_FULL;
+	mode_reason.clear();
+
+	// GDI doesn't kern so widths can be added up a character at a time, DirectWrite might
+	width_policy = editor.GetTechnology() == SC_TECHNOLOGY_DEFAULT ? WIDTH_TABLE : WIDTH_PROPORTIONAL;
+
+	if (get_document_mode() == MODE_DISABLED) {
+		degrade(MODE_DISABLED, std::string("only tabs can be aligned on screen, converting to spaces aligns the cells split on '") + separator + "'");
+	}
+	else if (get_document_mode() == MODE_VIEWPORT) {
+		degrade(MODE_VIEWPORT, "the document is larger than max_document_size");
+	}
 }
 
 static int calc_tab_width(int text_width_in_tab) {
@@ -98,18 +588,33 @@ static bool change_line(int& location, direction which_dir) {
 	return (location >= 0);
 }
 
-static int get_nof_tabs_between(int start, int end) {
-	unsigned char current_char = 0;
-	int tabs = 0;
-
-	while (start < end && (current_char = (unsigned char)editor.GetCharAt(start))) {
-		if (current_char == '\t') {
-			tabs++;
+// Separators are single bytes so the line can be scanned a byte at a time, other than DBCS trail bytes
+// which can look like a separator and are skipped
+static const char *next_separator(const char *c, const char *eol, bool &quoted) {
+	for (; c < eol; ++c) {
+		if (dbcs_lead_bytes[(unsigned char)*c]) {
+			if (c + 1 < eol) ++c;
 		}
-		start = editor.PositionAfter(start);
+		else if (quoted_separators && *c == '"') quoted = !quoted;
+		else if (*c == separator && !quoted) break;
+	}
+	return c;
+}
+
+// Quotes are followed from the start of the line
+static int get_nof_separators_between(int start, int end) {
+	const int line_start = get_line_start(start);
+	const char *text = editor.GetRangePointer(line_start, end - line_start);
+	const char *from = text + (start - line_start);
+	const char *eol = text + (end - line_start);
+	bool quoted = false;
+	int separators = 0;
+
+	for (const char *c = next_separator(text, eol, quoted); c < eol; c = next_separator(c + 1, eol, quoted)) {
+		if (c >= from) separators++;
 	}
 
-	return tabs;
+	return separators;
 }
 
 struct et_tabstop {
@@ -123,57 +628,62 @@ struct et_tabstop {
 	}
 };
 
+template<typename Width>
 static void measure_cells(std::vector<std::vector<et_tabstop>> &grid, int start_line, int end_line, size_t editted_cell) {
 	int current_pos = editor.PositionFromLine(start_line);
 	direction which_dir = (start_line <= end_line ? FORWARDS : BACKWARDS);
 
 	do {
-		unsigned char current_char = (unsigned char)editor.GetCharAt(current_pos);
+		const int line_start = current_pos;
 		const int line_end = get_line_end(current_pos);
-		int cell_start = current_pos;
-		bool cell_empty = true;
+
+		if (max_line_length > 0 && (size_t)(line_end - line_start) > max_line_length) {
+			degrade(MODE_DISABLED, "line " + std::to_string(editor.LineFromPosition(current_pos) + 1) + " is longer than max_line_length");
+			return;
+		}
+
+		const char *text = editor.GetRangePointer(line_start, line_end - line_start);
+		const char *eol = text + (line_end - line_start);
+		const char *cell_start = text;
+		bool quoted = false;
 		size_t cell_num = 0;
 		std::vector<et_tabstop> grid_line;
 
-		while (current_pos != line_end) {
-			if (current_char == '\t') {
-				if (cell_num >= editted_cell) {
-#ifdef _DEBUG
-					// Highlight the cell
-					editor.SetIndicatorCurrent(grid_line.size() % DBG_INDICATORS);
-					if (cell_empty) editor.IndicatorFillRange(current_pos, 1);
-					else editor.IndicatorFillRange(cell_start, current_pos - cell_start + 1);
+		for (const char *c = next_separator(text, eol, quoted); c < eol; c = next_separator(c + 1, eol, quoted)) {
+			if (cell_num >= editted_cell) {
+#ifdef DEBUG_TOOLS
+				// Highlight the cell
+				editor.SetIndicatorCurrent(grid_line.size() % DBG_INDICATORS);
+				editor.IndicatorFillRange(line_start + (int)(cell_start - text), (int)(c - cell_start) + 1);
 #endif
-					int text_width_in_tab = 0;
-					if (!cell_empty) {
-						text_width_in_tab = get_text_width(cell_start, current_pos);
-					}
-					grid_line.push_back({ calc_tab_width(text_width_in_tab), text_width_in_tab, nullptr });
-				}
-				else {
-					grid_line.push_back({ 0, 0, nullptr });
+				int text_width_in_tab = 0;
+				if (c > cell_start) {
+					text_width_in_tab = Width::width(line_start + (int)(cell_start - text), line_start + (int)(c - text), cell_start);
 				}
-				cell_empty = true;
-				cell_num++;
+				counters.cells_measured++;
+				grid_line.push_back({ calc_tab_width(text_width_in_tab), text_width_in_tab, nullptr });
 			}
 			else {
-				if (cell_empty) {
-					cell_start = current_pos;
-					cell_empty = false;
-				}
+				grid_line.push_back({ 0, 0, nullptr });
 			}
+			cell_start = c + 1;
+			cell_num++;
 
-			current_pos = editor.PositionAfter(current_pos);
-			current_char = (unsigned char)editor.GetCharAt(current_pos);
+			if (max_cells_per_line > 0 && cell_num == max_cells_per_line + 1) {
+				degrade(MODE_MONOSPACE, "line " + std::to_string(editor.LineFromPosition(line_start) + 1) + " has more than max_cells_per_line cells");
+			}
 		}
 
+		current_pos = line_end;
+
 		if (grid_line.size() <= editted_cell && !(which_dir == FORWARDS && editor.LineFromPosition(current_pos) <= end_line)) {
 			break;
 		}
 
 		grid.push_back(grid_line);
+		counters.lines_measured++;
 
-		if (current_char == '\0') break;
+		if (current_pos >= editor.GetLength()) break;
 
 		int cur_line = editor.LineFromPosition(current_pos);
 		if (cur_line < startLine || cur_line > endLine) break;
@@ -182,6 +692,23 @@ static void measure_cells(std::vector<std::vector<et_tabstop>> &grid, int start_
 	return;
 }
 
+// Measures the block around the editted line, returns the line the block starts on
+template<typename Width>
+static size_t measure_block(std::vector<std::vector<et_tabstop>> &grid, int block_edit_linenum, int block_min_end, size_t editted_cell) {
+	if (block_edit_linenum > 0) {
+		TraceScope trace("measure backward");
+		measure_cells<Width>(grid, block_edit_linenum - 1, -1, editted_cell);
+		std::reverse(grid.begin(), grid.end());
+	}
+	size_t block_start_linenum = block_edit_linenum - grid.size();
+	{
+		TraceScope trace("measure forward");
+		measure_cells<Width>(grid, block_edit_linenum, block_min_end, editted_cell);
+	}
+
+	return block_start_linenum;
+}
+
 static void stretch_cells(std::vector<std::vector<et_tabstop>> &grid, size_t start_cell, size_t max_tabs) {
 	// Find columns blocks and stretch to fit the widest cell
 	for (size_t t = start_cell; t < max_tabs; t++) {
@@ -214,12 +741,26 @@ static void stretch_tabstops(int block_edit_linenum, int block_min_end, int edit
 	size_t max_tabs = 0;
 	size_t block_start_linenum;
 
-	if (block_edit_linenum > 0) {
-		measure_cells(grid, block_edit_linenum - 1, -1, editted_cell);
-		std::reverse(grid.begin(), grid.end());
+	if (mode == MODE_DISABLED) return;
+
+#ifdef DEBUG_TOOLS
+	LARGE_INTEGER start_time;
+	QueryPerformanceCounter(&start_time);
+#endif
+
+	switch (width_policy) {
+		case WIDTH_MONOSPACE:
+			block_start_linenum = measure_block<et_width_monospace>(grid, block_edit_linenum, block_min_end, editted_cell);
+			break;
+		case WIDTH_TABLE:
+			block_start_linenum = measure_block<et_width_table>(grid, block_edit_linenum, block_min_end, editted_cell);
+			break;
+		default:
+			block_start_linenum = measure_block<et_width_proportional>(grid, block_edit_linenum, block_min_end, editted_cell);
+			break;
 	}
-	block_start_linenum = block_edit_linenum - grid.size();
-	measure_cells(grid, block_edit_linenum, block_min_end, editted_cell);
+
+	if (mode == MODE_DISABLED) return;
 
 	for (const auto &grid_line : grid) {
 		max_tabs = __max(max_tabs, grid_line.size());
@@ -227,173 +768,1463 @@ static void stretch_tabstops(int block_edit_linenum, int block_min_end, int edit
 
 	if (grid.size() == 0 || max_tabs == 0) return;
 
-#ifdef _DEBUG
+#ifdef DEBUG_TOOLS
 	// Mark the start and end of the block being recomputed
-	editor.MarkerAdd((int)block_start_linenum - 1, MARK_UNDERLINE);
-	editor.MarkerAdd((int)(block_start_linenum + grid.size() - 1), MARK_UNDERLINE);
+	if (block_start_linenum > 0) {
+		debug_marks->marker_handles.push_back(editor.MarkerAdd((int)block_start_linenum - 1, MARK_UNDERLINE));
+	}
+	debug_marks->marker_handles.push_back(editor.MarkerAdd((int)(block_start_linenum + grid.size() - 1), MARK_UNDERLINE));
 #endif
 
+	TraceBegin("stretch");
 	stretch_cells(grid, editted_cell, max_tabs);
+	TraceEnd("stretch");
+
+	TraceScope trace("apply");
 
 	// Anything before the editted cell we can keep because we already know what it is
-	std::vector<int> known_tabstops;
-	int cur_tabstop = 0;
-	for (int i = 0; i < editted_cell; i++) {
-		cur_tabstop = editor.GetNextTabStop((int)block_start_linenum, cur_tabstop);
-		known_tabstops.push_back(cur_tabstop);
-	}
+	const std::vector<int> &edit_line_tabstops = line_tabstops->get(block_edit_linenum);
+	const std::vector<int> known_tabstops(edit_line_tabstops.begin(), edit_line_tabstops.begin() + editted_cell);
 
 	// Set tabstops
 	for (size_t l = 0; l < grid.size(); l++) {
-		size_t current_line_num = block_start_linenum + l;
-		int acc_tabstop = 0;
-
-		editor.ClearTabStops((int)current_line_num);
-
-		// Set any known tabstops
-		for (size_t t = 0; t < known_tabstops.size(); t++) {
-			acc_tabstop = known_tabstops[t];
-			editor.AddTabStop((int)current_line_num, acc_tabstop);
-		}
+		std::vector<int> tabstops(known_tabstops);
+		int acc_tabstop = known_tabstops.empty() ? 0 : known_tabstops.back();
 
 		for (size_t t = known_tabstops.size(); t < grid[l].size(); t++) {
 			acc_tabstop += *(grid[l][t].widest_width_pix);
-			editor.AddTabStop((int)current_line_num, acc_tabstop);
+			tabstops.push_back(acc_tabstop);
 		}
+
+		set_tabstops((int)(block_start_linenum + l), std::move(tabstops));
 	}
 
+#ifdef DEBUG_TOOLS
+	// Show how long the block took below its first line
+	LARGE_INTEGER end_time, frequency;
+	QueryPerformanceCounter(&end_time);
+	QueryPerformanceFrequency(&frequency);
+
+	char timing[128];
+	snprintf(timing, sizeof(timing), "%.3f ms, %Iu lines, %Iu cells from cell %d",
+		(end_time.QuadPart - start_time.QuadPart) * 1000.0 / frequency.QuadPart, grid.size(), max_tabs, editted_cell);
+	editor.AnnotationSetText((int)block_start_linenum, timing);
+	editor.AnnotationSetStyle((int)block_start_linenum, STYLE_DEFAULT);
+	debug_marks->annotated_lines.add((int)block_start_linenum, (int)block_start_linenum + 1);
+#endif
+
 	return;
 }
 
-static void replace_nth_tab(int linenum, int cellnum, const char *text) {
-	Sci_TextToFind ttf;
+// Lexers style text lazily, make sure the view is styled before it gets measured. Any lines that
+// change style while this happens end up in restyled_lines.
+static void style_view() {
+	if (width_policy == WIDTH_MONOSPACE || mode == MODE_DISABLED) return;
 
-	ttf.chrg.cpMin = editor.PositionFromLine(linenum);
-	ttf.chrg.cpMax = editor.GetLineEndPosition(linenum);
-	ttf.lpstrText = "\t";
+	const int end = endLine + 1 < editor.GetLineCount() ? editor.PositionFromLine(endLine + 1) : editor.GetLength();
+	const int end_styled = editor.GetEndStyled();
+	if (end_styled < end) editor.Colourise(end_styled, end);
+}
 
-	int position = INVALID_POSITION;
-	int curcell = -1;
-	do {
-		position = editor.FindText(0, &ttf);
-		ttf.chrg.cpMin = position + 1; // Move start of the search forward
-		curcell++;
-	} while (position != INVALID_POSITION && curcell != cellnum);
+static int get_reference_width() {
+	return measure_text(STYLE_DEFAULT, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
+}
 
-	if (position == INVALID_POSITION) {
-		return;
+static uint64_t get_content_hash() {
+	// FNV-1a
+	const unsigned char *text = (const unsigned char *)editor.GetCharacterPointer();
+	const size_t length = (size_t)editor.GetLength();
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ text[i]) * 1099511628211ull;
 	}
 
-	editor.SetTargetRange(position, position + 1);
-	editor.ReplaceTarget(-1, text);
+	return hash;
 }
 
-void ElasticTabstopsSwitchToScintilla(HWND sci, const Configuration *config) {
-	editor.SetScintillaInstance(sci);
+static const uint32_t *get_snapshot_offsets() {
+	return reinterpret_cast<const uint32_t *>(snapshot + 1);
+}
 
-	// Adjust widths based on character size
-	// The width of a tab is (tab_width_minimum + tab_width_padding)
-	// Since the user can adjust the padding we adjust the minimum
-	char_width = editor.TextWidth(STYLE_DEFAULT, " ");
-	tab_width_padding = (int)(char_width * config->min_padding);
-	tab_width_minimum = __max(char_width * editor.GetTabWidth() - tab_width_padding, 0);
+static const int32_t *get_snapshot_tabstops() {
+	return reinterpret_cast<const int32_t *>(get_snapshot_offsets() + snapshot->line_count + 1);
+}
+
+// The file could be truncated or written by something else, so make sure every offset stays inside
+// it before apply_snapshot() reads through them.
+static bool snapshot_offsets_valid(size_t file_size) {
+	const size_t offsets_size = ((size_t)snapshot->line_count + 1) * sizeof(uint32_t);
+	if (file_size < sizeof(et_snapshot_header) + offsets_size) return false;
+
+	const uint32_t *offsets = get_snapshot_offsets();
+	if (offsets[0] != 0) return false;
+	for (uint32_t line = 0; line < snapshot->line_count; line++) {
+		if (offsets[line + 1] < offsets[line]) return false;
+	}
 
-	get_text_width = get_text_width_prop;
+	const size_t tabstops_size = file_size - sizeof(et_snapshot_header) - offsets_size;
+	return tabstops_size % sizeof(int32_t) == 0 && tabstops_size / sizeof(int32_t) == offsets[snapshot->line_count];
 }
 
-void ElasticTabstopsComputeCurrentView() {
-	int linesOnScreen = editor.LinesOnScreen();
-	startLine = editor.GetFirstVisibleLine();
-	endLine = startLine + linesOnScreen + 1;
+// Sets the view's tabstops straight from the snapshot. Only lines the earlier session computed are in
+// it, so if any line in view has a different number of tabs than it has tabstops it gets measured as usual.
+static bool apply_snapshot() {
+	if (snapshot == nullptr || mode == MODE_DISABLED || separator != '\t') return false;
 
-	// Expand up to 1 "screen" worth in both directions
-	startLine -= linesOnScreen;
-	endLine += linesOnScreen;
+	const uint32_t *offsets = get_snapshot_offsets();
+	const int32_t *tabstops = get_snapshot_tabstops();
 
-	startLine = __max(startLine, 0);
-	endLine = __min(endLine, editor.GetLineCount());
+	for (int line = startLine; line < endLine; line++) {
+		const int line_start = editor.PositionFromLine(line);
+		const int line_length = get_line_end(line_start) - line_start;
+		const char *text = editor.GetRangePointer(line_start, line_length);
 
-	clear_debug_marks();
-	stretch_tabstops(startLine, endLine, 0);
-}
+		if ((uint32_t)std::count(text, text + line_length, '\t') != offsets[line + 1] - offsets[line]) return false;
+	}
 
-void ElasticTabstopsOnModify(int start, int end, int linesAdded, bool hasTab) {
-	clear_debug_marks();
+	TraceScope trace("apply snapshot");
+	for (int line = startLine; line < endLine; line++) {
+		set_tabstops(line, std::vector<int>(tabstops + offsets[line], tabstops + offsets[line + 1]));
+	}
 
-	int editted_cell = 0;
-	// If the modifications happen on a single line and doesnt add/remove tabs, we can do some heuristics to skip some computations
-	if (linesAdded == 0 && !hasTab) {
-		// See if there are any tabs after the inserted/removed text
-		if (get_nof_tabs_between(end, get_line_end(end)) == 0) return;
+	return true;
+}
 
-		// Find which cell was actually changed
-		editted_cell = get_nof_tabs_between(get_line_start(start), start);
+// Sets the tabstops back to what they were when the plugin was disabled, including the rest of the
+// blocks the view cuts through. Lines scrolled to in the meantime were never computed, so as with a
+// snapshot, any line in view with a different number of separators than tabstops means it gets
+// measured as usual.
+static bool apply_suspended() {
+	if (suspended_document != editor.GetDocPointer() || mode == MODE_DISABLED ||
+		suspended_separator != separator || suspended_quoted_separators != quoted_separators ||
+		suspended_reference_width != get_reference_width()) return false;
+
+	for (int line = startLine; line < endLine; line++) {
+		const int line_start = editor.PositionFromLine(line);
+		if ((size_t)get_nof_separators_between(line_start, get_line_end(line_start)) != suspended_tabstops.get(line).size()) return false;
 	}
 
-	int block_start_linenum = editor.LineFromPosition(start);
+	TraceScope trace("apply suspended");
+	suspended_tabstops.for_each_line([](int line) {
+		set_tabstops(line, std::vector<int>(suspended_tabstops.get(line)));
+	});
 
-	stretch_tabstops(block_start_linenum, block_start_linenum + (linesAdded > 0 ? linesAdded : 0), editted_cell);
+	return true;
 }
 
-void ElasticTabstopsConvertToSpaces(const Configuration *config) {
-	std::vector<std::vector<et_tabstop>> grid;
+// Converting to spaces works on the raw document buffer rather than through the editor so that
+// independent segments of the document can be measured and stretched on worker threads. Column
+// blocks never span a line without tabs, so splitting on those lines can't change the result.
+struct et_segment {
+	const char *begin;
+	const char *end;
+	std::string result;
+	size_t lines;
+	size_t cells;
+};
+
+static const char *next_line(const char *pos, const char *end, const char **eol) {
+	while (pos < end && *pos != '\r' && *pos != '\n') pos++;
+	*eol = pos;
+	if (pos < end && *pos == '\r') pos++;
+	if (pos < end && *pos == '\n') pos++;
+	return pos;
+}
 
-	// Recompute the entire document
-	startLine = 0;
-	endLine = editor.GetLineCount();
-	measure_cells(grid, 0, editor.GetLineCount(), 0);
+static bool line_has_separator(const char *begin, const char *eol) {
+	return memchr(begin, separator, eol - begin) != nullptr;
+}
 
-	clear_debug_marks();
+// Steps over a character in any code page other than UTF-8
+static const char *next_character(const char *c, const char *end) {
+	return c + (dbcs_lead_bytes[(unsigned char)*c] && c + 1 < end ? 2 : 1);
+}
 
-	size_t max_tabs = 0;
-	for (const auto &grid_line : grid) {
-		max_tabs = __max(max_tabs, grid_line.size());
+static int count_characters(const char *begin, const char *end) {
+	int characters = 0;
+	if (code_page == SC_CP_UTF8) {
+		for (; begin < end; ++begin) {
+			// Only count UTF-8 lead bytes
+			if ((*begin & 0xC0) != 0x80) characters++;
+		}
 	}
+	else {
+		for (; begin < end; begin = next_character(begin, end)) characters++;
+	}
+	return characters;
+}
 
-	if (grid.size() == 0 || max_tabs == 0) return;
+static void convert_segment(et_segment &segment, bool convert_leading_tabs) {
+	std::vector<std::vector<et_tabstop>> grid;
+	size_t max_tabs = 0;
 
-	stretch_cells(grid, 0, max_tabs);
+	// Measure the cells. Spaces can only represent whole character columns, so
+	// widths are taken in characters instead of asking the editor for pixels
+	const char *line = segment.begin;
+	while (line < segment.end) {
+		const char *eol;
+		const char *next = next_line(line, segment.end, &eol);
+		const char *cell_start = line;
+		bool quoted = false;
+		std::vector<et_tabstop> grid_line;
 
-	editor.BeginUndoAction();
-	for (size_t linenum = 0; linenum < grid.size(); ++linenum) {
-		editor.ClearTabStops((int) linenum);
+		// Anything other than a tab stays in the text so it is part of the cell's width
+		const int separator_width = (separator == '\t' ? 0 : 1);
+		for (const char *c = next_separator(line, eol, quoted); c < eol; c = next_separator(c + 1, eol, quoted)) {
+			int text_width_in_tab = (count_characters(cell_start, c) + separator_width) * char_width;
+			grid_line.push_back({ calc_tab_width(text_width_in_tab), text_width_in_tab, nullptr });
+			cell_start = c + 1;
+		}
+
+		max_tabs = __max(max_tabs, grid_line.size());
+		segment.cells += grid_line.size();
+		grid.push_back(std::move(grid_line));
+		line = next;
+	}
 
-		int start_cell = 0;
+	segment.lines = grid.size();
+	stretch_cells(grid, 0, max_tabs);
 
-		if (!config->convert_leading_tabs_to_spaces) {
-			const int default_width = calc_tab_width(0);
+	const int default_width = calc_tab_width(0);
+	segment.result.reserve(segment.end - segment.begin);
+	line = segment.begin;
+	for (const auto &grid_line : grid) {
+		const char *eol;
+		const char *next = next_line(line, segment.end, &eol);
+		size_t start_cell = 0;
+		size_t cell = 0;
+		bool quoted = false;
 
+		if (!convert_leading_tabs && separator == '\t') {
 			// Assume any leading "normal" tabs are for indentation
-			while (start_cell < (int)grid[linenum].size() &&
-				grid[linenum][start_cell].text_width_pix == 0 &&
-				grid[linenum][start_cell].getTabLen() == default_width)
+			while (start_cell < grid_line.size() &&
+				grid_line[start_cell].text_width_pix == 0 &&
+				grid_line[start_cell].getTabLen() == default_width)
 				start_cell++;
 		}
 
-		// Iterate backwards since tabs are being removed, thus it wouldn't find the correct "nth" tab
-		for (int end_cell = (int)grid[linenum].size() - 1; end_cell >= start_cell; --end_cell) {
-			int spaces = grid[linenum][end_cell].getTabLen() / char_width;
-			replace_nth_tab((int)linenum, (int)end_cell, std::string(spaces, ' ').c_str());
+		const char *c = line;
+		for (const char *sep = next_separator(line, eol, quoted); sep < eol; sep = next_separator(sep + 1, eol, quoted)) {
+			segment.result.append(c, sep);
+			if (separator != '\t' || cell < start_cell) {
+				segment.result.push_back(*sep);
+			}
+			if (cell >= start_cell) {
+				segment.result.append(grid_line[cell].getTabLen() / char_width, ' ');
+			}
+			cell++;
+			c = sep + 1;
 		}
+		segment.result.append(c, next);
+
+		line = next;
 	}
-	editor.EndUndoAction();
 }
 
-void ElasticTabstopsOnReady(HWND sci) {
-#ifdef _DEBUG
-	// Setup the markers for start/end of the computed block
-	int mask = (int)SendMessage(sci, SCI_GETMARGINMASKN, SC_MARGIN_SYBOL, 0);
-	SendMessage(sci, SCI_SETMARGINMASKN, SC_MARGIN_SYBOL, mask | (1 << MARK_UNDERLINE));
-	SendMessage(sci, SCI_MARKERDEFINE, MARK_UNDERLINE, SC_MARK_UNDERLINE);
-	SendMessage(sci, SCI_MARKERSETBACK, MARK_UNDERLINE, 0x77CC77);
+static std::vector<et_segment> split_segments(const char *text, size_t length, size_t count) {
+	std::vector<et_segment> segments;
+	const char *end = text + length;
+	const char *begin = text;
 
-	// Setup indicators for column blocks
-	for (int i = 0; i < DBG_INDICATORS; ++i) {
-		SendMessage(sci, SCI_INDICSETSTYLE, i, INDIC_FULLBOX);
-		SendMessage(sci, SCI_INDICSETALPHA, i, 200);
-		SendMessage(sci, SCI_INDICSETOUTLINEALPHA, i, 255);
-		SendMessage(sci, SCI_INDICSETUNDER, i, true);
-	}
+	for (size_t i = 1; i <= count && begin < end; ++i) {
+		const char *split = (i == count ? end : text + length * i / count);
+		const char *eol;
+
+		if (split <= begin) continue;
+
+		// Move to the start of the next line, then on to the next line without any tabs
+		bool line_start = split[-1] == '\n' || (split[-1] == '\r' && (split == end || *split != '\n'));
+		if (!line_start) split = next_line(split, end, &eol);
+		while (split < end) {
+			next_line(split, end, &eol);
+			if (!line_has_separator(split, eol)) break;
+			split = next_line(split, end, &eol);
+		}
+
+		segments.push_back({ begin, split, std::string(), 0, 0 });
+		begin = split;
+	}
+
+	return segments;
+}
+
+// Converting spaces back to tabs looks for columns where runs of spaces end at the same character
+// column on consecutive lines. Lines are streamed through a bounded window so deciding whether a
+// column is real never needs more than SPACES_WINDOW lines of lookahead.
+#define SPACES_WINDOW 64
+
+enum et_candidate_type {
+	CANDIDATE_END,   // Text or the end of the line follows the run of spaces
+	CANDIDATE_INNER  // Inside a run of spaces, this is where an empty cell would have ended
+};
+
+struct et_candidate {
+	int column;
+	const char *run_begin;
+	const char *run_end;
+	et_candidate_type type;
+	bool strong; // A single space could just be between two words
+	bool leading; // Nothing but indentation comes before it
+	bool accepted;
+};
+
+struct et_spaced_line {
+	const char *begin;
+	const char *next;
+	std::vector<et_candidate> candidates;
+};
+
+struct et_open_column {
+	size_t first_line;
+	size_t end_count;
+	size_t strong_count;
+	size_t text_count;
+};
+
+class SpacesToTabs {
+private:
+	std::deque<et_spaced_line> window;
+	size_t window_start = 0;
+	size_t last_indent = 0;
+	std::map<int, et_open_column> open_columns;
+	std::string result;
+
+	// Lines indented with spaces line up too, but without text in it on any line it is just indentation
+	static bool is_column(const et_open_column &column) {
+		return column.end_count >= 2 && column.strong_count > 0 && column.text_count > 0;
+	}
+
+	static et_candidate *find_candidate(et_spaced_line &line, int column) {
+		for (auto &candidate : line.candidates) {
+			if (candidate.column == column) return &candidate;
+		}
+		return nullptr;
+	}
+
+	void accept(int column, size_t first_line, size_t end_line) {
+		for (size_t l = __max(first_line, window_start); l < end_line; ++l) {
+			find_candidate(window[l - window_start], column)->accepted = true;
+		}
+	}
+
+	void close(std::map<int, et_open_column>::iterator it, size_t end_line) {
+		if (is_column(it->second)) {
+			accept(it->first, it->second.first_line, end_line);
+		}
+	}
+
+	void close_all(size_t end_line) {
+		for (auto it = open_columns.begin(); it != open_columns.end(); ++it) {
+			close(it, end_line);
+		}
+		open_columns.clear();
+	}
+
+	void emit_front() {
+		const et_spaced_line &line = window.front();
+		auto candidate = line.candidates.begin();
+		const char *c = line.begin;
+
+		while (c < line.next) {
+			if (candidate == line.candidates.end() || c != candidate->run_begin) {
+				result.push_back(*c++);
+				continue;
+			}
+
+			// Replace the run of spaces with a tab for each accepted column within it
+			const char *run_end = candidate->run_end;
+			int end_column = 0;
+			int tab_column = -1;
+			for (; candidate != line.candidates.end() && candidate->run_begin == c; ++candidate) {
+				if (candidate->accepted) {
+					result.push_back('\t');
+					tab_column = candidate->column;
+				}
+				end_column = candidate->column;
+			}
+
+			if (tab_column == -1) result.append(c, run_end);
+			else result.append(end_column - tab_column, ' ');
+			c = run_end;
+		}
+
+		window.pop_front();
+		window_start++;
+	}
+
+	void emit_decided() {
+		// Force a decision on anything that would otherwise grow the window past its limit
+		while (window.size() > SPACES_WINDOW) {
+			for (auto &column : open_columns) {
+				if (column.second.first_line > window_start) continue;
+
+				if (is_column(column.second)) {
+					accept(column.first, column.second.first_line, window_start + 1);
+				}
+				else {
+					const et_candidate *candidate = find_candidate(window.front(), column.first);
+					if (candidate->type == CANDIDATE_END) column.second.end_count--;
+					if (candidate->strong) column.second.strong_count--;
+					if (!candidate->leading) column.second.text_count--;
+					column.second.first_line = window_start + 1;
+				}
+			}
+			emit_front();
+		}
+
+		size_t first_undecided = window_start + window.size();
+		for (const auto &column : open_columns) {
+			first_undecided = __min(first_undecided, column.second.first_line);
+		}
+		while (window_start < first_undecided) {
+			emit_front();
+		}
+	}
+
+public:
+	void add_line(const char *begin, const char *eol, const char *next) {
+		const size_t line_num = window_start + window.size();
+		et_spaced_line line = { begin, next, {} };
+
+		// Leading tabs are indentation and only lines with the same indentation can line up
+		const char *c = begin;
+		while (c < eol && *c == '\t') c++;
+		const size_t indent = c - begin;
+		const char *content = c;
+
+		if (memchr(c, '\t', eol - c) == nullptr) {
+			int column = 0;
+			while (c < eol) {
+				if (*c != ' ') {
+					// Counted the same as converting to spaces counts it, no trail byte is ever a space
+					const char *text = c;
+					while (c < eol && *c != ' ') c++;
+					column += count_characters(text, c);
+					continue;
+				}
+
+				const char *run_begin = c;
+				const int run_column = column;
+				while (c < eol && *c == ' ') {
+					c++;
+					column++;
+				}
+
+				for (int inner = run_column + 1; inner < column; ++inner) {
+					line.candidates.push_back({ inner, run_begin, c, CANDIDATE_INNER, false, run_begin == content, false });
+				}
+				line.candidates.push_back({ column, run_begin, c, CANDIDATE_END, c - run_begin > 1, run_begin == content, false });
+			}
+		}
+
+		if (indent != last_indent) {
+			close_all(line_num);
+			last_indent = indent;
+		}
+
+		// Extend the columns that continue on to this line, the rest are closed
+		std::map<int, et_open_column> continued;
+		for (const auto &candidate : line.candidates) {
+			et_open_column column = { line_num, 0, 0, 0 };
+			auto it = open_columns.find(candidate.column);
+			if (it != open_columns.end()) {
+				column = it->second;
+				open_columns.erase(it);
+			}
+			if (candidate.type == CANDIDATE_END) column.end_count++;
+			if (candidate.strong) column.strong_count++;
+			if (!candidate.leading) column.text_count++;
+			continued.emplace_hint(continued.end(), candidate.column, column);
+		}
+		close_all(line_num);
+		open_columns.swap(continued);
+
+		window.push_back(std::move(line));
+		emit_decided();
+	}
+
+	std::string finish() {
+		close_all(window_start + window.size());
+		while (!window.empty()) {
+			emit_front();
+		}
+		return std::move(result);
+	}
+};
+
+// Remeasures a few of the cached widths, fonts hint differently at each size so widths don't always
+// scale with the zoom and the fonts might have changed since. A few samples can't tell which style
+// changed, so every style measured so far must still have its font.
+static bool width_cache_matches(const et_width_cache &cache) {
+	for (int style = 0; style <= STYLE_MAX; style++) {
+		if (!cache.font_keys[style].empty() && cache.font_keys[style] != get_font_key(style)) return false;
+	}
+
+	int samples = 0;
+	for (const auto &text_width : cache.text_widths) {
+		if (samples++ == WIDTH_CACHE_SAMPLES) break;
+		if (measure_text((unsigned char)text_width.first[0], text_width.first.c_str() + 1) != text_width.second) return false;
+	}
+
+	samples = 0;
+	for (int style = 0; style <= STYLE_MAX && samples < WIDTH_CACHE_SAMPLES; style++) {
+		for (int c = ' '; c < 128 && samples < WIDTH_CACHE_SAMPLES; c++) {
+			if (cache.char_widths[style][c] == 0) continue;
+
+			const char text[2] = { (char)c, '\0' };
+			if (measure_text(style, text) != cache.char_widths[style][c]) return false;
+			samples++;
+		}
+	}
+
+	return true;
+}
+
+// Picks the cache for the current document and zoom level. A zoom level that hasn't been measured yet
+// starts with the widths of the closest one that has, as long as they rescale exactly. This only saves
+// measuring, the tabstops are still recomputed from the widths.
+static void use_width_cache() {
+	const sptr_t document = editor.GetDocPointer();
+	const int zoom = editor.GetZoom();
+	const int reference_width = get_reference_width();
+
+	auto &cache = width_caches[{ document, zoom }];
+	if (cache && cache->reference_width == reference_width && width_cache_matches(*cache)) {
+		width_cache = cache.get();
+		return;
+	}
+
+	if (width_caches.size() > MAX_WIDTH_CACHES) {
+		// Most of these are likely to be for documents that have been closed
+		for (auto it = width_caches.begin(); it != width_caches.end();) {
+			if (it->first.first != document) {
+				if (it->second) remember_font_metrics(*it->second);
+				it = width_caches.erase(it);
+			}
+			else ++it;
+		}
+	}
+
+	// The fonts have changed but what was measured with the old ones still holds for them
+	if (cache) remember_font_metrics(*cache);
+
+	cache.reset(new et_width_cache());
+	memset(cache->char_widths, 0, sizeof(cache->char_widths));
+	cache->reference_width = reference_width;
+	width_cache = cache.get();
+
+	const et_width_cache *closest = nullptr;
+	int closest_distance = 0;
+	for (const auto &other : width_caches) {
+		if (other.first.first != document || other.second.get() == width_cache) continue;
+
+		const int distance = abs(other.first.second - zoom);
+		if (closest == nullptr || distance < closest_distance) {
+			closest = other.second.get();
+			closest_distance = distance;
+		}
+	}
+
+	if (closest == nullptr) return;
+
+	auto rescale = [&](int width) {
+		return (int)(((long long)width * reference_width + closest->reference_width / 2) / closest->reference_width);
+	};
+
+	for (const auto &text_width : closest->text_widths) {
+		width_cache->text_widths.emplace(text_width.first, rescale(text_width.second));
+	}
+
+	for (int style = 0; style <= STYLE_MAX; style++) {
+		for (int c = ' '; c < 128; c++) {
+			width_cache->char_widths[style][c] = rescale(closest->char_widths[style][c]);
+		}
+	}
+
+	if (!width_cache_matches(*width_cache)) {
+		width_cache->text_widths.clear();
+		memset(width_cache->char_widths, 0, sizeof(width_cache->char_widths));
+	}
+}
+
+// Restyled text can change width, but Notepad++ doesn't ask for style changes. The mask is shared with
+// Notepad++ and any other plugin, adding to it only sends them more SCN_MODIFIED notifications, which
+// they already tell apart by modificationType. Notepad++ can set the mask again at any time, so it is
+// checked on every switch rather than only once.
+static void request_style_changes(const ScintillaEditor &sci) {
+	const int eventMask = sci.GetModEventMask();
+	if ((eventMask & SC_MOD_CHANGESTYLE) == 0) sci.SetModEventMask(eventMask | SC_MOD_CHANGESTYLE);
+}
+
+// Drops everything kept for the document, the width caches are remembered by font first
+static void forget_document(sptr_t document) {
+	document_tabstops.erase(document);
+#ifdef DEBUG_TOOLS
+	document_debug_marks.erase(document);
+#endif
+
+	for (auto it = width_caches.begin(); it != width_caches.end();) {
+		if (it->first.first == document) {
+			if (it->second) remember_font_metrics(*it->second);
+			it = width_caches.erase(it);
+		}
+		else ++it;
+	}
+}
+
+// Only Notepad++ hands out window handles, anywhere else Scintilla is reached through its direct function
+#ifdef _WIN32
+void ElasticTabstopsSwitchToScintilla(HWND sci, const Configuration *config) {
+	ElasticTabstopsSwitchToEditor(ScintillaEditor(sci), config);
+}
+#endif
+
+// Same as above for a Scintilla that is only reachable through its direct function
+void ElasticTabstopsSwitchToEditor(const ScintillaEditor &sci, const Configuration *config) {
+	if (closed_document != 0) {
+		forget_document(closed_document);
+		closed_document = 0;
+	}
+
+	editor = sci;
+	request_style_changes(editor);
+	release_snapshot();
+	line_tabstops = &document_tabstops[editor.GetDocPointer()];
+	if (!tabstops_match_editor()) clear_tabstops();
+
+#ifdef DEBUG_TOOLS
+	// Whatever was left in this document the last time it was shown is out of date
+	debug_marks = &document_debug_marks[editor.GetDocPointer()];
+	clear_debug_marks();
+#endif
+
+	max_document_size = config->max_document_size;
+	max_line_length = config->max_line_length;
+	max_cells_per_line = config->max_cells_per_line;
+	max_block_height = config->max_block_height;
+
+	const int page = editor.GetCodePage();
+	if (page != code_page) {
+		code_page = page;
+		for (int b = 0; b < 256; b++) {
+			dbcs_lead_bytes[b] = code_page != 0 && code_page != SC_CP_UTF8 && IsDBCSLeadByteEx(code_page, (BYTE)b);
+		}
+	}
+
+	// Adjust widths based on character size
+	// The width of a tab is (tab_width_minimum + tab_width_padding)
+	// Since the user can adjust the padding we adjust the minimum
+	char_width = measure_text(STYLE_DEFAULT, " ");
+	tab_width_padding = (int)(char_width * config->min_padding);
+	tab_width_minimum = __max(char_width * editor.GetTabWidth() - tab_width_padding, 0);
+
+	use_width_cache();
+	reset_mode();
+}
+
+void ElasticTabstopsSetSeparator(char sep, bool quoted) {
+	// Quotes are only meaningful for delimited data, tabs inside quotes in code still separate cells
+	separator = sep;
+	quoted_separators = quoted && sep != '\t';
+}
+
+void ElasticTabstopsComputeCurrentView() {
+	int linesOnScreen = editor.LinesOnScreen();
+	firstVisibleLine = editor.GetFirstVisibleLine();
+	scroll_velocity = 0;
+	startLine = firstVisibleLine;
+	endLine = startLine + linesOnScreen + 1;
+
+	// Expand up to 1 "screen" worth in both directions
+	if (mode == MODE_FULL) {
+		startLine -= linesOnScreen;
+		endLine += linesOnScreen;
+	}
+
+	startLine = __max(startLine, 0);
+	endLine = __min(endLine, editor.GetLineCount());
+
+	clear_debug_marks();
+	style_view();
+	if (!apply_snapshot() && !apply_suspended()) stretch_tabstops(startLine, endLine, 0);
+	release_suspended();
+
+	// Everything in view is now up to date with the latest styles
+	restyled_lines.clear();
+}
+
+// Redoes the blocks of any restyled lines within the view. Widths are cached by style as well as
+// text so none of those need to be thrown away, just the blocks.
+static void compute_restyled() {
+	LineRanges restyled;
+	std::swap(restyled, restyled_lines);
+
+	restyled.for_each_range([](int start, int end) {
+		start = __max(start, startLine);
+		end = __min(end, endLine + 1);
+		if (start < end) stretch_tabstops(start, end - 1, 0);
+	});
+}
+
+// Edits that scroll past what has been computed, such as pasting more lines than fit on screen, only
+// need the part that can now be seen. Everything else is computed when it gets scrolled to, inserted
+// lines start out without any tabstops.
+static bool edit_scrolled_view() {
+	const int first_visible_line = editor.GetFirstVisibleLine();
+	if (first_visible_line == firstVisibleLine) return false;
+	if (first_visible_line >= startLine && first_visible_line + editor.LinesOnScreen() + 1 <= endLine) return false;
+
+	ElasticTabstopsComputeCurrentView();
+	return true;
+}
+
+// Scrolling tends to keep going the same way, so lines are prefetched ahead of it, more the faster it
+// goes. Lines behind it have just been seen and are left as they are. A scroll only computes anything
+// once less than half of what was prefetched is left, which is never less than a screen.
+#define PREFETCH_SCROLLS 8
+#define MIN_PREFETCH_SCREENS 2
+#define MAX_PREFETCH_SCREENS 6
+
+void ElasticTabstopsOnScroll() {
+	const int first_visible_line = editor.GetFirstVisibleLine();
+	const int scrolled = first_visible_line - firstVisibleLine;
+	if (scrolled == 0) return;
+
+	const int lines_on_screen = editor.LinesOnScreen();
+	const int last_visible_line = first_visible_line + lines_on_screen + 1;
+
+	// Jumping somewhere else entirely has no direction to speak of
+	if (mode != MODE_FULL || snapshot != nullptr || first_visible_line > endLine || last_visible_line < startLine) {
+		ElasticTabstopsComputeCurrentView();
+		return;
+	}
+
+	firstVisibleLine = first_visible_line;
+	if ((scrolled > 0) != (scroll_velocity > 0)) scroll_velocity = scrolled;
+	else scroll_velocity = (scroll_velocity + scrolled) / 2;
+
+	const int ahead = __min(__max(abs(scroll_velocity) * PREFETCH_SCROLLS, lines_on_screen * MIN_PREFETCH_SCREENS), lines_on_screen * MAX_PREFETCH_SCREENS);
+	const int line_count = editor.GetLineCount();
+
+	clear_debug_marks();
+
+	if (scrolled > 0) {
+		if (endLine - last_visible_line >= ahead / 2 || endLine >= line_count) return;
+
+		// Only a screen's worth behind is still counted as computed
+		const int computed_end = endLine;
+		startLine = __max(startLine, first_visible_line - lines_on_screen);
+		endLine = __min(last_visible_line + ahead, line_count);
+
+		style_view();
+		stretch_tabstops(computed_end, endLine, 0);
+	}
+	else {
+		if (first_visible_line - startLine >= ahead / 2 || startLine <= 0) return;
+
+		const int computed_start = startLine;
+		startLine = __max(first_visible_line - ahead, 0);
+		endLine = __min(endLine, last_visible_line + lines_on_screen);
+
+		style_view();
+		stretch_tabstops(startLine, computed_start, 0);
+	}
+
+	compute_restyled();
+}
+
+// Gets ready to compute what an edit to the lines from first_line to last_line changed, returns false
+// if that has already been taken care of
+static bool begin_edit(int first_line, int last_line) {
+	// The edit might have taken the document past a limit or back under one. Only the size can be told
+	// up front, for the others the view is measured again.
+	if (mode != get_document_mode()) {
+		reset_mode();
+		ElasticTabstopsComputeCurrentView();
+		return false;
+	}
+
+	if (mode == MODE_DISABLED || edit_scrolled_view()) return false;
+
+	clear_debug_marks();
+
+	// An edit can change the styles of lines after it (e.g. starting a comment), those get picked up
+	// while styling the view. The edited lines are restyled too, but computing the edit measures them
+	// again anyway, only from the edited cell on.
+	style_view();
+	restyled_lines.remove(first_line, last_line + 1);
+	compute_restyled();
+
+	return true;
+}
+
+void ElasticTabstopsOnModify(int start, int end, int linesAdded, bool hasSeparator) {
+	const int first_line = editor.LineFromPosition(start);
+	if (!begin_edit(first_line, first_line + (linesAdded > 0 ? linesAdded : 0))) return;
+
+	int editted_cell = 0;
+	// If the modifications happen on a single line and doesnt add/remove tabs, we can do some heuristics to skip some computations
+	if (linesAdded == 0 && !hasSeparator) {
+		// See if there are any tabs after the inserted/removed text
+		if (get_nof_separators_between(end, get_line_end(end)) == 0) return;
+
+		// Find which cell was actually changed
+		editted_cell = get_nof_separators_between(get_line_start(start), start);
+
+		// The cells before it can only be kept if they've been computed
+		if (line_tabstops->get(first_line).size() < (size_t)editted_cell) editted_cell = 0;
+	}
+
+	stretch_tabstops(first_line, first_line + (linesAdded > 0 ? linesAdded : 0), editted_cell);
+}
+
+// Several edits that each stayed on their line without adding or removing tabs, like typing with
+// multiple carets or in a rectangular selection
+void ElasticTabstopsOnModifyColumn(int firstLine, int lastLine, int edits) {
+	if (!begin_edit(firstLine, lastLine)) return;
+
+	// Anything outside the view gets computed when it is scrolled to
+	firstLine = __max(firstLine, startLine);
+	lastLine = __min(lastLine, endLine);
+	if (firstLine > lastLine) return;
+
+	size_t editted_cell = 0;
+
+	// If every edit was made at a caret the carets show which cells were changed
+	if (edits == editor.GetSelections()) {
+		bool tabs_after = false;
+		editted_cell = SIZE_MAX;
+
+		for (int i = 0; i < edits; i++) {
+			const int caret = editor.GetSelectionNCaret(i);
+			editted_cell = __min(editted_cell, (size_t)get_nof_separators_between(get_line_start(caret), caret));
+			tabs_after = tabs_after || get_nof_separators_between(caret, get_line_end(caret)) > 0;
+		}
+
+		if (!tabs_after) return;
+
+		// The cells before it can only be kept if they've been computed and are the same on every line
+		const std::vector<int> &first_tabstops = line_tabstops->get(firstLine);
+		for (int line = firstLine; line <= lastLine && editted_cell > 0; line++) {
+			const std::vector<int> &tabstops = line_tabstops->get(line);
+			if (tabstops.size() <= editted_cell || !std::equal(tabstops.begin(), tabstops.begin() + editted_cell, first_tabstops.begin())) {
+				editted_cell = 0;
+			}
+		}
+	}
+
+	stretch_tabstops(firstLine, lastLine, (int)editted_cell);
+}
+
+void ElasticTabstopsOnStyleChanged(int position, int length) {
+	// Monospaced widths don't depend on the style
+	if (width_policy == WIDTH_MONOSPACE) return;
+
+	// Restyling a whole line ends at the start of the next one, which isn't restyled
+	restyled_lines.add(editor.LineFromPosition(position), editor.LineFromPosition(position + __max(length - 1, 0)) + 1);
+}
+
+void ElasticTabstopsComputeRestyled() {
+	if (restyled_lines.empty()) return;
+
+	clear_debug_marks();
+	compute_restyled();
+}
+
+static void shift_lines(int line, int linesAdded) {
+	line_tabstops->shift(line, linesAdded);
+	restyled_lines.shift(line, linesAdded);
+
+	// What was computed moves with its lines, as does the view, Scintilla keeps the same lines on screen
+	for (int *window_line : { &startLine, &endLine, &firstVisibleLine }) {
+		if (*window_line > line) *window_line = __max(line + 1, *window_line + linesAdded);
+	}
+#ifdef DEBUG_TOOLS
+	debug_marks->annotated_lines.shift(line, linesAdded);
+#endif
+}
+
+void ElasticTabstopsOnLinesChanged(int position, int linesAdded) {
+	// Any edit at all means the snapshot no longer matches
+	release_snapshot();
+
+	// Nothing is tracked until the first switch
+	if (linesAdded == 0 || line_tabstops == nullptr) return;
+
+	const int line = editor.LineFromPosition(position);
+
+	if (batch_overflowed) {
+		overflowed_lines.shift(line, linesAdded);
+	}
+	else if (batching) {
+		if (batched_line_changes.size() < MAX_BATCHED_LINE_CHANGES) {
+			batched_line_changes.push_back({ line, linesAdded });
+			return;
+		}
+
+		batch_overflowed = true;
+		line_tabstops->for_each_line([](int tracked) {
+			overflowed_lines.add(tracked, tracked + 1);
+		});
+		for (const auto &change : batched_line_changes) {
+			overflowed_lines.shift(change.first, change.second);
+		}
+		overflowed_lines.shift(line, linesAdded);
+	}
+	else {
+		shift_lines(line, linesAdded);
+	}
+}
+
+// Lines inserted or deleted in the other view. Only what is kept for its document moves, a document
+// that is shown in both views is moved by the current view's notifications.
+void ElasticTabstopsOnDocumentLinesChanged(sptr_t document, int line, int linesAdded) {
+	auto it = document_tabstops.find(document);
+	if (it == document_tabstops.end() || &it->second == line_tabstops) return;
+
+	it->second.shift(line, linesAdded);
+#ifdef DEBUG_TOOLS
+	auto marks = document_debug_marks.find(document);
+	if (marks != document_debug_marks.end()) marks->second.annotated_lines.shift(line, linesAdded);
+#endif
+}
+
+// Every shift moves all the lines after it, so a flood of them (like undoing a replace all) is
+// gathered up and only dealt with once it's over
+void ElasticTabstopsBeginLinesChanged() {
+	batching = true;
+	batch_overflowed = false;
+	batched_line_changes.clear();
+}
+
+void ElasticTabstopsEndLinesChanged() {
+	if (!batching) return;
+	batching = false;
+
+	if (batch_overflowed) {
+		// Too many to follow one by one so start over, only clearing the lines the tabstops could have gone to
+		overflowed_lines.for_each_line([](int line) {
+			editor.ClearTabStops(line);
+		});
+		overflowed_lines.clear();
+		line_tabstops->clear();
+#ifdef DEBUG_TOOLS
+		editor.AnnotationClearAll();
+		debug_marks->annotated_lines.clear();
+#endif
+		batch_overflowed = false;
+	}
+	else {
+		for (const auto &change : batched_line_changes) {
+			shift_lines(change.first, change.second);
+		}
+	}
+
+	batched_line_changes.clear();
+}
+
+void ElasticTabstopsSaveSnapshot(const std::wstring &path) {
+	if (mode == MODE_DISABLED || separator != '\t') return;
+
+	TraceScope trace("save snapshot");
+
+	et_snapshot_header header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, get_content_hash(), get_reference_width(), tab_width_minimum, tab_width_padding, (uint32_t)editor.GetLineCount() };
+
+	std::vector<uint32_t> offsets(1, 0);
+	std::vector<int32_t> tabstops;
+	for (uint32_t line = 0; line < header.line_count; line++) {
+		const std::vector<int> &stops = line_tabstops->get((int)line);
+		tabstops.insert(tabstops.end(), stops.begin(), stops.end());
+		offsets.push_back((uint32_t)tabstops.size());
+	}
+
+	if (tabstops.empty()) return;
+
+	FILE *file = _wfopen(path.c_str(), L"wb");
+	if (file == nullptr) return;
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), file);
+	fwrite(tabstops.data(), sizeof(int32_t), tabstops.size(), file);
+	fclose(file);
+}
+
+bool ElasticTabstopsLoadSnapshot(const std::wstring &path) {
+	release_snapshot();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && (size_t)size.QuadPart >= sizeof(et_snapshot_header)) {
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	CloseHandle(file); // The mapping keeps the file open
+	if (mapping == nullptr) return false;
+
+	const et_snapshot_header *header = (const et_snapshot_header *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (header == nullptr) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	snapshot = header;
+	snapshot_mapping = mapping;
+
+	// Everything but the content is cheap to check so do that first
+	bool valid = header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION &&
+		header->reference_width == get_reference_width() &&
+		header->tab_width_minimum == tab_width_minimum &&
+		header->tab_width_padding == tab_width_padding &&
+		header->line_count == (uint32_t)editor.GetLineCount() &&
+		snapshot_offsets_valid((size_t)size.QuadPart) &&
+		header->content_hash == get_content_hash();
+
+	if (!valid) release_snapshot();
+
+	return valid;
+}
+
+template<typename T>
+static bool read_value(FILE *file, T &value) {
+	return fread(&value, sizeof(T), 1, file) == 1;
+}
+
+static bool read_string(FILE *file, std::string &text) {
+	uint32_t length;
+	if (!read_value(file, length) || length > 4096) return false;
+
+	text.resize(length);
+	return length == 0 || fread(&text[0], 1, length, file) == length;
+}
+
+static void write_string(FILE *file, const std::string &text) {
+	const uint32_t length = (uint32_t)text.size();
+	fwrite(&length, sizeof(length), 1, file);
+	fwrite(text.data(), 1, length, file);
+}
+
+void ElasticTabstopsSaveFontMetrics(const std::wstring &path) {
+	for (const auto &cache : width_caches) {
+		if (cache.second) remember_font_metrics(*cache.second);
+	}
+
+	if (font_metrics.empty()) return;
+
+	FILE *file = _wfopen(path.c_str(), L"wb");
+	if (file == nullptr) return;
+
+	const uint32_t header[] = { FONT_METRICS_MAGIC, FONT_METRICS_VERSION, (uint32_t)font_metrics.size() };
+	fwrite(header, sizeof(header), 1, file);
+
+	for (const auto &font : font_metrics) {
+		write_string(file, font.first);
+		fwrite(font.second.char_widths, sizeof(font.second.char_widths), 1, file);
+
+		const uint32_t count = (uint32_t)font.second.text_widths.size();
+		fwrite(&count, sizeof(count), 1, file);
+		for (const auto &text_width : font.second.text_widths) {
+			write_string(file, text_width.first);
+			fwrite(&text_width.second, sizeof(text_width.second), 1, file);
+		}
+	}
+
+	fclose(file);
+}
+
+void ElasticTabstopsLoadFontMetrics(const std::wstring &path) {
+	FILE *file = _wfopen(path.c_str(), L"rb");
+	if (file == nullptr) return;
+
+	TraceScope trace("load font metrics");
+
+	uint32_t header[3];
+	if (!read_value(file, header) || header[0] != FONT_METRICS_MAGIC || header[1] != FONT_METRICS_VERSION) {
+		fclose(file);
+		return;
+	}
+
+	// A damaged file only loses the fonts that come after the damage
+	for (uint32_t i = 0; i < header[2] && font_metrics.size() < MAX_FONT_METRICS; i++) {
+		std::string font_key;
+		et_font_metrics metrics;
+		uint32_t count;
+		if (!read_string(file, font_key) || !read_value(file, metrics.char_widths) || !read_value(file, count)) break;
+
+		bool complete = true;
+		for (uint32_t j = 0; j < count && complete; j++) {
+			std::string text;
+			int width;
+			complete = read_string(file, text) && read_value(file, width);
+			if (complete && metrics.text_widths.size() < MAX_SAVED_TEXT_WIDTHS) metrics.text_widths.emplace(std::move(text), width);
+		}
+		if (!complete) break;
+
+		font_metrics.emplace(std::move(font_key), std::move(metrics));
+	}
+
+	fclose(file);
+}
+
+void ElasticTabstopsClearTabstops() {
+	clear_tabstops();
+}
+
+// Clears the tabstops when the plugin is disabled, but keeps them to put back when it is enabled again.
+// Anything that changes the text or the fonts while it is disabled has to drop them.
+void ElasticTabstopsSuspend() {
+	suspended_document = editor.GetDocPointer();
+	suspended_tabstops = *line_tabstops;
+	suspended_reference_width = get_reference_width();
+	suspended_separator = separator;
+	suspended_quoted_separators = quoted_separators;
+	clear_tabstops();
+}
+
+void ElasticTabstopsDropSuspended() {
+	release_suspended();
+}
+
+// The styles were changed, by switching the language or in the style configurator. What was measured
+// is kept by font, the caches are rebuilt from it on the next switch.
+void ElasticTabstopsDropWidths() {
+	for (const auto &cache : width_caches) {
+		if (cache.second) remember_font_metrics(*cache.second);
+	}
+	width_caches.clear();
+	width_cache = nullptr;
+}
+
+// Notepad++ is closing the document, its pointer can be reused by the next one
+void ElasticTabstopsForgetDocument(sptr_t document) {
+	if (document == suspended_document) release_suspended();
+
+	// The current document is still shown until Notepad++ switches to another one
+	auto it = document_tabstops.find(document);
+	if (it != document_tabstops.end() && &it->second == line_tabstops) {
+		line_tabstops->clear();
+		closed_document = document;
+	}
+	else {
+		forget_document(document);
+	}
+}
+
+void ElasticTabstopsConvertToSpaces(const Configuration *config) {
+	TraceScope trace("convert to spaces");
+
+	// Roughly 1MB of text per thread, anything smaller isn't worth spinning up threads for
+	const size_t length = (size_t)editor.GetLength();
+	const size_t threads = __max(1u, __min(std::thread::hardware_concurrency(), (unsigned)(length >> 20) + 1));
+
+	clear_debug_marks();
+
+	// The pointer stays valid as long as the document isn't modified, which can't happen until the segments are joined
+	std::vector<et_segment> segments = split_segments(editor.GetCharacterPointer(), length, threads);
+	std::vector<std::thread> workers;
+
+	for (size_t i = 1; i < segments.size(); ++i) {
+		workers.emplace_back(convert_segment, std::ref(segments[i]), config->convert_leading_tabs_to_spaces);
+	}
+	if (!segments.empty()) {
+		convert_segment(segments[0], config->convert_leading_tabs_to_spaces);
+	}
+	for (auto &worker : workers) {
+		worker.join();
+	}
+
+	std::string text;
+	text.reserve(length);
+	for (const auto &segment : segments) {
+		text.append(segment.result);
+		counters.lines_measured += segment.lines;
+		counters.cells_measured += segment.cells;
+	}
+
+	// Nothing was converted
+	if (text.compare(0, std::string::npos, editor.GetCharacterPointer(), length) == 0) return;
+
+	editor.BeginUndoAction();
+	editor.SetTargetRange(0, (int)length);
+	editor.ReplaceTarget(text);
+	clear_tabstops();
+	editor.EndUndoAction();
+}
+
+static bool line_has_separator(int line) {
+	const int position = editor.PositionFromLine(line);
+	const int length = editor.GetLineEndPosition(line) - position;
+	const char *text = editor.GetRangePointer(position, length);
+	return line_has_separator(text, text + length);
+}
+
+// The lines the selection touches, a selection ending at the start of a line doesn't include it
+static void get_selected_lines(int &first_line, int &last_line) {
+	const int start = editor.GetSelectionStart();
+	const int end = editor.GetSelectionEnd();
+
+	first_line = editor.LineFromPosition(start);
+	last_line = editor.LineFromPosition(end);
+	if (last_line > first_line && editor.PositionFromLine(last_line) == end) last_line--;
+}
+
+// Converts the lines from first_line to last_line, without the last line's line end. Only the blocks
+// they are part of get measured, as far as max_block_height lines either side.
+static std::string convert_lines(int first_line, int last_line, bool convert_leading_tabs) {
+	const int line_count = editor.GetLineCount();
+	const int reach = max_block_height > 0 ? (int)max_block_height : line_count;
+
+	int block_first = first_line;
+	while (block_first > 0 && first_line - block_first < reach && line_has_separator(block_first - 1)) block_first--;
+
+	int block_last = last_line;
+	while (block_last + 1 < line_count && block_last - last_line < reach && line_has_separator(block_last + 1)) block_last++;
+
+	const int block_start = editor.PositionFromLine(block_first);
+	const int block_end = block_last + 1 < line_count ? editor.PositionFromLine(block_last + 1) : editor.GetLength();
+	const char *text = editor.GetRangePointer(block_start, block_end - block_start);
+
+	et_segment segment = { text, text + (block_end - block_start), std::string(), 0, 0 };
+	convert_segment(segment, convert_leading_tabs);
+	counters.lines_measured += segment.lines;
+	counters.cells_measured += segment.cells;
+
+	// Cut the selected lines back out of the block
+	const char *result = segment.result.data();
+	const char *result_end = result + segment.result.size();
+	const char *eol = result;
+	for (int line = block_first; line < first_line; line++) {
+		result = next_line(result, result_end, &eol);
+	}
+
+	const char *selected = result;
+	for (int line = first_line; line <= last_line; line++) {
+		result = next_line(result, result_end, &eol);
+	}
+
+	return std::string(selected, eol);
+}
+
+void ElasticTabstopsConvertSelectionToSpaces(const Configuration *config) {
+	TraceScope trace("convert selection to spaces");
+
+	int first_line, last_line;
+	get_selected_lines(first_line, last_line);
+
+	const int start = editor.PositionFromLine(first_line);
+	const int end = editor.GetLineEndPosition(last_line);
+	const std::string text = convert_lines(first_line, last_line, config->convert_leading_tabs_to_spaces);
+
+	// Nothing was converted
+	if (text.compare(0, std::string::npos, editor.GetRangePointer(start, end - start), end - start) == 0) return;
+
+	clear_debug_marks();
+
+	editor.BeginUndoAction();
+	editor.SetTargetRange(start, end);
+	editor.ReplaceTarget(text);
+	editor.SetSel(start, start + (int)text.size());
+	editor.EndUndoAction();
+
+	// The converted lines don't have any tabs left to be stopped
+	for (int line = first_line; line <= last_line; line++) {
+		set_tabstops(line, std::vector<int>());
+	}
+}
+
+void ElasticTabstopsCopySelectionAsSpaces(const Configuration *config) {
+	TraceScope trace("copy selection as spaces");
+
+	int first_line, last_line;
+	get_selected_lines(first_line, last_line);
+
+	editor.CopyText(convert_lines(first_line, last_line, config->convert_leading_tabs_to_spaces));
+}
+
+std::string ElasticTabstopsGetStatus() {
+	static const char *mode_names[] = { "Full", "Visible lines only", "Monospace estimation", "Disabled" };
+
+	std::string status = std::string("Mode: ") + mode_names[mode];
+	if (!mode_reason.empty()) {
+		status += "\nReason: " + mode_reason;
+	}
+	return status;
+}
+
+// Finds the separator ending each cell of the line, as offsets from the start of the line
+static const char *get_cell_ends(int line, int &length, std::vector<int> &cell_ends) {
+	const int position = editor.PositionFromLine(line);
+	length = editor.GetLineEndPosition(line) - position;
+
+	const char *text = editor.GetRangePointer(position, length);
+	const char *eol = text + length;
+	bool quoted = false;
+
+	cell_ends.clear();
+	for (const char *c = next_separator(text, eol, quoted); c < eol; c = next_separator(c + 1, eol, quoted)) {
+		cell_ends.push_back((int)(c - text));
+	}
+	return text;
+}
+
+static bool query_lines(const ElasticTabstopsLines *lines) {
+	if (lines->callback == nullptr) return false;
+
+	const int last_line = __min(lines->lastLine, editor.GetLineCount() - 1);
+	std::vector<int> cell_ends;
+
+	for (int line = __max(lines->firstLine, 0); line <= last_line; line++) {
+		ElasticTabstopsLine result;
+		result.line = line;
+		result.position = editor.PositionFromLine(line);
+		result.text = get_cell_ends(line, result.length, cell_ends);
+		result.cell_ends = cell_ends.data();
+		result.cells = (int)cell_ends.size();
+
+		const std::vector<int> &tabstops = line_tabstops->get(line);
+		result.tabstops = tabstops.data();
+		result.tabstops_count = (int)tabstops.size();
+
+		if (!lines->callback(&result, lines->param)) break;
+	}
+
+	return true;
+}
+
+static bool query_block(ElasticTabstopsBlock *block) {
+	block->firstLine = -1;
+	block->lastLine = -1;
+
+	if (block->line < 0 || block->line >= editor.GetLineCount() || block->cell < 0) return false;
+
+	// Laying out gives every line of a block a tabstop for the cell, so the block is the lines around it
+	// that have one. Nothing is measured, lines that haven't been laid out don't have any.
+	auto has_cell = [&](int line) {
+		return (int)line_tabstops->get(line).size() > block->cell;
+	};
+
+	if (!has_cell(block->line)) return true;
+
+	block->firstLine = block->line;
+	while (block->firstLine > 0 && has_cell(block->firstLine - 1)) block->firstLine--;
+
+	block->lastLine = block->line;
+	while (has_cell(block->lastLine + 1)) block->lastLine++;
+
+	return true;
+}
+
+// Other plugins ask about the current document, which is only the tracked one while it is enabled
+static bool tracking_current_document() {
+	if (line_tabstops == nullptr) return false;
+
+	auto it = document_tabstops.find(editor.GetDocPointer());
+	return it != document_tabstops.end() && &it->second == line_tabstops;
+}
+
+bool ElasticTabstopsQuery(long message, void *info) {
+	if (info == nullptr) return false;
+
+	switch (message) {
+		case ETM_GETVERSION:
+			*static_cast<int *>(info) = ETM_API_VERSION;
+			return true;
+		case ETM_GETLINES:
+			return tracking_current_document() && query_lines(static_cast<const ElasticTabstopsLines *>(info));
+		case ETM_GETBLOCK:
+			return tracking_current_document() && query_block(static_cast<ElasticTabstopsBlock *>(info));
+		default:
+			return false;
+	}
+}
+
+// Converting to spaces keeps any other separator and pads the cell after it, so converting back only
+// has to take out the spaces that follow each separator. Spaces a cell started with are taken out too.
+static std::string remove_padding(const char *text, const char *end) {
+	std::string result;
+	result.reserve(end - text);
+
+	for (const char *line = text, *eol; line < end; ) {
+		const char *next = next_line(line, end, &eol);
+		const char *c = line;
+		bool quoted = false;
+
+		for (const char *sep = next_separator(line, eol, quoted); sep < eol; sep = next_separator(sep + 1, eol, quoted)) {
+			result.append(c, sep + 1);
+			c = sep + 1;
+			while (c < eol && *c == ' ') c++;
+		}
+		result.append(c, next);
+
+		line = next;
+	}
+
+	return result;
+}
+
+void ElasticTabstopsConvertToTabs() {
+	TraceScope trace("convert to tabs");
+
+	const size_t length = (size_t)editor.GetLength();
+	const char *text = editor.GetCharacterPointer();
+	const char *end = text + length;
+	std::string result;
+
+	if (separator != '\t') {
+		result = remove_padding(text, end);
+	}
+	else {
+		SpacesToTabs converter;
+
+		for (const char *line = text, *eol; line < end; ) {
+			const char *next = next_line(line, end, &eol);
+			converter.add_line(line, eol, next);
+			line = next;
+		}
+
+		result = converter.finish();
+	}
+
+	// Nothing was converted
+	if (result.compare(0, std::string::npos, text, length) == 0) return;
+
+	editor.BeginUndoAction();
+	editor.SetTargetRange(0, (int)length);
+	editor.ReplaceTarget(result);
+	editor.EndUndoAction();
+}
+
+const ElasticTabstopsCounters *ElasticTabstopsGetCounters() {
+	return &counters;
+}
+
+void ElasticTabstopsResetCounters() {
+	counters = {};
+}
+
+#ifdef _WIN32
+void ElasticTabstopsOnReady(HWND sci) {
+	request_style_changes(ScintillaEditor(sci));
+
+#ifdef DEBUG_TOOLS
+	// Setup the markers for start/end of the computed block
+	int mask = (int)SendMessage(sci, SCI_GETMARGINMASKN, SC_MARGIN_SYBOL, 0);
+	SendMessage(sci, SCI_SETMARGINMASKN, SC_MARGIN_SYBOL, mask | (1 << MARK_UNDERLINE));
+	SendMessage(sci, SCI_MARKERDEFINE, MARK_UNDERLINE, SC_MARK_UNDERLINE);
+	SendMessage(sci, SCI_MARKERSETBACK, MARK_UNDERLINE, 0x77CC77);
+
+	// Show the timing of each block
+	SendMessage(sci, SCI_ANNOTATIONSETVISIBLE, ANNOTATION_BOXED, 0);
+
+	// Setup indicators for column blocks
+	for (int i = 0; i < DBG_INDICATORS; ++i) {
+		SendMessage(sci, SCI_INDICSETSTYLE, i, INDIC_FULLBOX);
+		SendMessage(sci, SCI_INDICSETALPHA, i, 200);
+		SendMessage(sci, SCI_INDICSETOUTLINEALPHA, i, 255);
+		SendMessage(sci, SCI_INDICSETUNDER, i, true);
+	}
 
 	// Setup indicator colors
 	SendMessage(sci, SCI_INDICSETFORE, 0, 0x90EE90);
@@ -406,3 +2237,4 @@ void ElasticTabstopsOnReady(HWND sci) {
 	SendMessage(sci, SCI_INDICSETFORE, 7, 0x2D882D);
 #endif
 }
+#endif
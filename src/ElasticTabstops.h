@@ -20,9 +20,48 @@
 
 #include "PluginInterface.h"
 #include "Config.h"
+#include "ScintillaEditor.h"
 
+// Deterministic measures of how much work the engine has done
+typedef struct ElasticTabstopsCounters {
+	size_t lines_measured;
+	size_t cells_measured;
+	size_t text_width_calls; // SCI_TEXTWIDTH, the rest is served by the width caches
+	size_t tabstops_set;
+}ElasticTabstopsCounters;
+
+#ifdef _WIN32
 void ElasticTabstopsSwitchToScintilla(HWND sci, const Configuration *config);
+#endif
+void ElasticTabstopsSwitchToEditor(const ScintillaEditor &sci, const Configuration *config);
+void ElasticTabstopsSetSeparator(char separator, bool quoted);
 void ElasticTabstopsComputeCurrentView();
-void ElasticTabstopsOnModify(int start, int end, int linesAdded, bool hasTab);
+void ElasticTabstopsOnScroll();
+void ElasticTabstopsOnModify(int start, int end, int linesAdded, bool hasSeparator);
+void ElasticTabstopsOnModifyColumn(int firstLine, int lastLine, int edits);
+void ElasticTabstopsOnLinesChanged(int position, int linesAdded);
+void ElasticTabstopsOnDocumentLinesChanged(sptr_t document, int line, int linesAdded);
+void ElasticTabstopsBeginLinesChanged();
+void ElasticTabstopsEndLinesChanged();
+void ElasticTabstopsOnStyleChanged(int position, int length);
+void ElasticTabstopsComputeRestyled();
+void ElasticTabstopsClearTabstops();
+void ElasticTabstopsSuspend();
+void ElasticTabstopsDropSuspended();
+void ElasticTabstopsDropWidths();
+void ElasticTabstopsForgetDocument(sptr_t document);
+void ElasticTabstopsSaveSnapshot(const std::wstring &path);
+bool ElasticTabstopsLoadSnapshot(const std::wstring &path);
+void ElasticTabstopsSaveFontMetrics(const std::wstring &path);
+void ElasticTabstopsLoadFontMetrics(const std::wstring &path);
 void ElasticTabstopsConvertToSpaces(const Configuration *config);
+void ElasticTabstopsConvertToTabs();
+void ElasticTabstopsConvertSelectionToSpaces(const Configuration *config);
+void ElasticTabstopsCopySelectionAsSpaces(const Configuration *config);
+std::string ElasticTabstopsGetStatus();
+bool ElasticTabstopsQuery(long message, void *info);
+const ElasticTabstopsCounters *ElasticTabstopsGetCounters();
+void ElasticTabstopsResetCounters();
+#ifdef _WIN32
 void ElasticTabstopsOnReady(HWND sci);
+#endif
@@ -0,0 +1,63 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+// Messages other plugins can send to query the column layout of the current document. Send them
+// with NPPM_MSGTOPLUGIN to L"ElasticTabstops.dll", with a CommunicationInfo whose internalMsg is one
+// of the messages below and whose info points to the struct the message describes.
+//
+// Nothing is copied, the pointers handed out point straight into the document and the plugin's own
+// state. They are only good until the callback returns.
+
+#define ETM_API_VERSION 1
+
+#define ETM_GETVERSION 1
+// int *info receives ETM_API_VERSION
+
+#define ETM_GETLINES 2
+// ElasticTabstopsLines *info, calls back with each line from firstLine to lastLine
+
+#define ETM_GETBLOCK 3
+// ElasticTabstopsBlock *info, finds the lines the column block containing the cell spans, as far as it
+// has been laid out
+
+typedef struct ElasticTabstopsLine {
+	int line;
+	int position;           // Position the line starts at
+	const char *text;       // The text of the line, without the line end
+	int length;
+	const int *cell_ends;   // Offset from position of the separator that ends each cell
+	int cells;
+	const int *tabstops;    // Tabstop of each cell in pixels, as set in the editor
+	int tabstops_count;     // 0 if the line hasn't been laid out
+} ElasticTabstopsLine;
+
+typedef struct ElasticTabstopsLines {
+	int firstLine;
+	int lastLine;
+	int (*callback)(const ElasticTabstopsLine *line, void *param); // Return 0 to stop early
+	void *param;
+} ElasticTabstopsLines;
+
+typedef struct ElasticTabstopsBlock {
+	int line;
+	int cell;      // 0 for the first cell
+	int firstLine; // Set to the first and last lines of the block,
+	int lastLine;  // or -1 if the line doesn't have the cell or hasn't been laid out
+} ElasticTabstopsBlock;
@@ -0,0 +1,214 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <random>
+#include "IncrementalCheck.h"
+#include "Corpus.h"
+#include "ElasticTabstops.h"
+
+#define EDITS_PER_SEQUENCE 50
+
+struct ic_edit {
+	int position;
+	int delete_length;
+	std::string text;
+};
+
+struct ic_divergence {
+	size_t edit;
+	int line;
+	std::vector<int> incremental;
+	std::vector<int> full;
+};
+
+static ScintillaEditor editor;
+static const Configuration *ic_config;
+
+static std::vector<std::vector<int>> get_view_tabstops(int &first_line) {
+	std::vector<std::vector<int>> tabstops;
+	const int lines_on_screen = editor.LinesOnScreen();
+
+	// Compare the same lines the view computes
+	first_line = __max(editor.GetFirstVisibleLine() - lines_on_screen, 0);
+	const int last_line = __min(editor.GetFirstVisibleLine() + 2 * lines_on_screen + 1, editor.GetLineCount());
+
+	for (int line = first_line; line < last_line; ++line) {
+		std::vector<int> line_tabstops;
+		for (int x = editor.GetNextTabStop(line, 0); x > 0; x = editor.GetNextTabStop(line, x)) {
+			line_tabstops.push_back(x);
+		}
+		tabstops.push_back(line_tabstops);
+	}
+
+	return tabstops;
+}
+
+// Applies the edit the same way Scintilla would notify the plugin about it
+static void apply_edit(const ic_edit &edit) {
+	const int length = editor.GetLength();
+	int position = __min(edit.position, length);
+	const int line_count = editor.GetLineCount();
+
+	// Neither the caret nor a selection can be between CR and LF
+	const char *text = editor.GetCharacterPointer();
+	if (position > 0 && position < length && text[position - 1] == '\r' && text[position] == '\n') position--;
+
+	if (edit.delete_length > 0) {
+		int delete_length = __min(edit.delete_length, length - position);
+		const int end = position + delete_length;
+		if (end < length && text[end - 1] == '\r' && text[end] == '\n') delete_length++;
+		std::string deleted(editor.GetCharacterPointer() + position, delete_length);
+		editor.DeleteRange(position, delete_length);
+
+		const int lines_added = editor.GetLineCount() - line_count;
+		if (lines_added != 0) ElasticTabstopsOnLinesChanged(position, lines_added);
+		ElasticTabstopsOnModify(position, position, lines_added, deleted.find('\t') != std::string::npos);
+	}
+	else {
+		editor.InsertText(position, edit.text);
+
+		const int lines_added = editor.GetLineCount() - line_count;
+		if (lines_added != 0) ElasticTabstopsOnLinesChanged(position, lines_added);
+		ElasticTabstopsOnModify(position, position + (int)edit.text.size(), lines_added, edit.text.find('\t') != std::string::npos);
+	}
+}
+
+// Replays the edits on the document, returns true if any of them diverged from a full recompute
+static bool replay(const std::string &document, const std::vector<ic_edit> &edits, ic_divergence &divergence) {
+	editor.SetText(document);
+	editor.SetFirstVisibleLine(0);
+	ElasticTabstopsSwitchToEditor(editor, ic_config);
+
+	// Setting the text isn't notified, so what the engine tracks is for the last sequence. Scintilla
+	// also keeps the first line's tabstops.
+	ElasticTabstopsClearTabstops();
+	ElasticTabstopsComputeCurrentView();
+
+	for (size_t e = 0; e < edits.size(); ++e) {
+		apply_edit(edits[e]);
+
+		int first_line;
+		const std::vector<std::vector<int>> incremental = get_view_tabstops(first_line);
+
+		// The full recompute starts from nothing, otherwise it would skip the lines the engine thinks
+		// are already right and stale tabstops left in the editor would match themselves
+		ElasticTabstopsClearTabstops();
+		for (int line = first_line; line < first_line + (int)incremental.size(); ++line) {
+			editor.ClearTabStops(line);
+		}
+		ElasticTabstopsComputeCurrentView();
+		const std::vector<std::vector<int>> full = get_view_tabstops(first_line);
+
+		for (size_t l = 0; l < incremental.size(); ++l) {
+			if (incremental[l] != full[l]) {
+				divergence = { e, first_line + (int)l, incremental[l], full[l] };
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static std::vector<ic_edit> random_edits(std::mt19937 &rng) {
+	static const char *insertions[] = { "x", "longer text", "\t", "a\tb", "\r\n", "x\t\r\n\t", "\t\t" };
+	std::vector<ic_edit> edits;
+
+	for (int i = 0; i < EDITS_PER_SEQUENCE; ++i) {
+		int position = (int)(rng() % (editor.GetLength() + 1));
+
+		if (rng() % 3 == 0) {
+			edits.push_back({ position, (int)(rng() % 5) + 1, "" });
+		}
+		else {
+			edits.push_back({ position, 0, insertions[rng() % (sizeof(insertions) / sizeof(insertions[0]))] });
+		}
+	}
+
+	return edits;
+}
+
+static std::string escape(const std::string &text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '\t') escaped += "\\t";
+		else if (c == '\r') escaped += "\\r";
+		else if (c == '\n') escaped += "\\n";
+		else escaped += c;
+	}
+	return escaped;
+}
+
+static std::string join_tabstops(const std::vector<int> &tabstops) {
+	std::string joined;
+	for (int x : tabstops) joined += std::to_string(x) + " ";
+	return joined.empty() ? "none" : joined;
+}
+
+std::string IncrementalCheckRun(const ScintillaEditor &sci, const Configuration *config, unsigned int seed, int sequences, bool *passed) {
+	editor = sci;
+	*passed = false;
+	ic_config = config;
+	ElasticTabstopsSetSeparator('\t', false);
+
+	std::mt19937 rng(seed);
+	for (int sequence = 0; sequence < sequences; ++sequence) {
+		// Blocks cut off by the edge of the view depend on where the view is, so keep the whole
+		// document inside it. The view reaches a screen beyond the visible lines.
+		CorpusParams params = CorpusPresets[0];
+		params.seed = rng();
+		params.lines = __max(editor.LinesOnScreen(), 10);
+
+		const std::string document = CorpusGenerate(&params);
+		editor.SetText(document);
+		std::vector<ic_edit> edits = random_edits(rng);
+
+		ic_divergence divergence;
+		if (!replay(document, edits, divergence)) continue;
+
+		// Shrink the edits by dropping anything that isn't needed to reproduce the divergence
+		edits.resize(divergence.edit + 1);
+		for (size_t i = 0; i < edits.size(); ) {
+			std::vector<ic_edit> shrunk = edits;
+			shrunk.erase(shrunk.begin() + i);
+
+			ic_divergence shrunk_divergence;
+			if (!shrunk.empty() && replay(document, shrunk, shrunk_divergence)) {
+				shrunk.resize(shrunk_divergence.edit + 1);
+				edits = shrunk;
+				divergence = shrunk_divergence;
+			}
+			else {
+				++i;
+			}
+		}
+
+		std::string report = "Sequence " + std::to_string(sequence) + " of seed " + std::to_string(seed) + " diverged after these edits:\n";
+		for (const auto &edit : edits) {
+			if (edit.delete_length > 0) report += "  delete " + std::to_string(edit.delete_length) + " at " + std::to_string(edit.position) + "\n";
+			else report += "  insert \"" + escape(edit.text) + "\" at " + std::to_string(edit.position) + "\n";
+		}
+		report += "Line " + std::to_string(divergence.line + 1) + "\n";
+		report += "  incremental: " + join_tabstops(divergence.incremental) + "\n";
+		report += "  full: " + join_tabstops(divergence.full) + "\n";
+		return report;
+	}
+
+	*passed = true;
+	return "No divergences in " + std::to_string(sequences) + " sequences of seed " + std::to_string(seed) + ".";
+}
@@ -0,0 +1,29 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include "PluginInterface.h"
+#include "Config.h"
+#include "ScintillaEditor.h"
+
+// Applies random edits in the given (scratch) editor and checks that the incremental recompute
+// ends up with the same tabstops as recomputing from scratch. Returns a readable report of the
+// first divergence, shrunk down to as few edits as possible, passed is false if there was one. Only
+// the editor is used, so this runs against any Scintilla with its direct function, without Notepad++.
+std::string IncrementalCheckRun(const ScintillaEditor &sci, const Configuration *config, unsigned int seed, int sequences, bool *passed);
@@ -0,0 +1,139 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <stdio.h>
+#include <string.h>
+#include "PluginDefinition.h"
+#include "Latency.h"
+
+// Buckets are exact below 2 * LATENCY_SUB_BUCKETS microseconds, after that each power of two is split
+// into LATENCY_SUB_BUCKETS buckets so every value is within about 3% of its bucket
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_BITS 40 // About 12 days
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS * (LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1))
+
+// Anything slower than this shows up as a dropped frame
+#define LATENCY_FRAME_BUDGET 16667
+
+struct latency_histogram {
+	unsigned int buckets[LATENCY_BUCKETS];
+	size_t count;
+	size_t over_budget;
+	long long max;
+};
+
+bool LatencyEnabled = true;
+
+static latency_histogram histograms[LATENCY_PATH_COUNT];
+static long long deferred[LATENCY_PATH_COUNT];
+
+static const char *path_names[LATENCY_PATH_COUNT] = {
+	"Update after an edit",
+	"Update after scrolling",
+	"Zoom",
+	"Switching buffers",
+	"Conversion"
+};
+
+static int get_bucket(long long value) {
+	if (value < 2 * LATENCY_SUB_BUCKETS) return (int)__max(value, 0);
+
+	int msb = 0;
+	while (msb < LATENCY_MAX_BITS - 1 && (value >> (msb + 1)) != 0) msb++;
+
+	const int shift = msb - LATENCY_SUB_BUCKET_BITS;
+	const int sub_bucket = (int)__min(value >> shift, 2 * LATENCY_SUB_BUCKETS - 1) - LATENCY_SUB_BUCKETS;
+	return LATENCY_SUB_BUCKETS * (shift + 1) + sub_bucket;
+}
+
+// The highest value that falls in the bucket
+static long long get_bucket_value(int bucket) {
+	if (bucket < 2 * LATENCY_SUB_BUCKETS) return bucket;
+
+	const int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+	return (((long long)(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+static long long get_percentile(const latency_histogram &histogram, double percentile) {
+	const size_t rank = (size_t)(histogram.count * percentile + 0.5);
+	size_t seen = 0;
+
+	for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		seen += histogram.buckets[bucket];
+		if (seen >= rank && seen > 0) return __min(get_bucket_value(bucket), histogram.max);
+	}
+	return histogram.max;
+}
+
+long long LatencyScope::now() {
+	static LARGE_INTEGER frequency;
+	if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+
+	// The counter counts from boot, multiplying it first would overflow after about 10 days at 10 MHz
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+}
+
+void LatencyRecord(LatencyPath path, long long microseconds) {
+	if (!LatencyEnabled) return;
+
+	microseconds += deferred[path];
+	deferred[path] = 0;
+
+	latency_histogram &histogram = histograms[path];
+
+	histogram.buckets[get_bucket(microseconds)]++;
+	histogram.count++;
+	if (microseconds > LATENCY_FRAME_BUDGET) histogram.over_budget++;
+	histogram.max = __max(histogram.max, microseconds);
+}
+
+void LatencyDefer(LatencyPath path, long long microseconds) {
+	if (!LatencyEnabled) return;
+
+	deferred[path] += microseconds;
+}
+
+std::string LatencyReport() {
+	std::string report;
+
+	for (int path = 0; path < LATENCY_PATH_COUNT; path++) {
+		const latency_histogram &histogram = histograms[path];
+
+		char line[256];
+		if (histogram.count == 0) {
+			snprintf(line, sizeof(line), "%s: nothing yet\n", path_names[path]);
+		}
+		else {
+			snprintf(line, sizeof(line), "%s: %Iu times, %Iu over %.1f ms\n    p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+				path_names[path], histogram.count, histogram.over_budget, LATENCY_FRAME_BUDGET / 1000.0,
+				get_percentile(histogram, 0.50) / 1000.0, get_percentile(histogram, 0.90) / 1000.0,
+				get_percentile(histogram, 0.99) / 1000.0, histogram.max / 1000.0);
+		}
+		report += line;
+	}
+
+	return report;
+}
+
+void LatencyReset() {
+	memset(histograms, 0, sizeof(histograms));
+	memset(deferred, 0, sizeof(deferred));
+}
@@ -0,0 +1,61 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+
+// How long the plugin takes to handle each kind of notification, kept as histograms so the slow
+// outliers aren't averaged away
+enum LatencyPath {
+	LATENCY_EDIT,
+	LATENCY_SCROLL,
+	LATENCY_ZOOM,
+	LATENCY_BUFFER_ACTIVATED,
+	LATENCY_CONVERSION,
+	LATENCY_PATH_COUNT
+};
+
+// Nothing is recorded while this is off, e.g. while replaying a recording
+extern bool LatencyEnabled;
+
+void LatencyRecord(LatencyPath path, long long microseconds);
+void LatencyDefer(LatencyPath path, long long microseconds);
+std::string LatencyReport();
+void LatencyReset();
+
+class LatencyScope final {
+private:
+	LatencyPath path;
+	bool deferred;
+	long long start;
+
+	static long long now();
+
+public:
+	explicit LatencyScope(LatencyPath path) : path(path), deferred(false), start(now()) {}
+
+	// Work done ahead of what is recorded for the path, such as handling the edits an update follows.
+	// Its time is added to the next latency recorded for the path.
+	LatencyScope(LatencyPath path, bool deferred) : path(path), deferred(deferred), start(now()) {}
+
+	~LatencyScope() {
+		if (deferred) LatencyDefer(path, now() - start);
+		else LatencyRecord(path, now() - start);
+	}
+};
@@ -16,36 +16,75 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
+#include <algorithm>
 #include <vector>
-#include <codecvt>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "PluginDefinition.h"
 #include "Version.h"
 #include "ElasticTabstops.h"
+#include "ElasticTabstopsMsgs.h"
 #include "AboutDialog.h"
 #include "resource.h"
 #include "Config.h"
+#include "Corpus.h"
+#include "Benchmark.h"
+#include "IncrementalCheck.h"
+#include "Trace.h"
+#include "Recording.h"
+#include "Latency.h"
+#include "menuCmdID.h"
 
 static HANDLE _hModule;
 static NppData nppData;
-static Configuration config = { true, {"*"}, 1, false };
+static Configuration config = { true, {"*"}, 1, false, {".csv:,", ".psv:|", ".ssv:;"}, true, 256 * 1024 * 1024, 100000, 1000, 10000, 0, false, false };
 
 // Helper functions
 static HWND getCurrentScintilla();
 static bool shouldProcessCurrentFile();
+static const char *getNotificationName(unsigned int code);
+static void updateTracing();
+static void updateRecording();
+static void recordNotification(const SCNotification *notify, bool isActive);
+static char getSeparatorForCurrentFile();
 
 // Menu callbacks
 static void toggleEnabled();
 static void convertEtToSpaces();
+static void convertSpacesToEt();
+static void convertSelectionToSpaces();
+static void copySelectionAsSpaces();
 static void editSettings();
+static void showStatus();
+static void showLatency();
+#ifdef DEBUG_TOOLS
+static void generateBenchmarkDocuments();
+static void runBenchmarks();
+static void saveBenchmarkBaseline();
+static void checkIncrementalRecompute();
+static void replayRecording();
+#endif
 static void showAbout();
 
 FuncItem funcItem[] = {
 	{ TEXT("Enable"), toggleEnabled, 0, config.enabled, nullptr },
 	{ TEXT(""), nullptr, 0, false, nullptr }, // separator
 	{ TEXT("Convert Tabstops to Spaces"), convertEtToSpaces, 0, false, nullptr },
+	{ TEXT("Convert Spaces to Tabstops"), convertSpacesToEt, 0, false, nullptr },
+	{ TEXT("Convert Selection to Spaces"), convertSelectionToSpaces, 0, false, nullptr },
+	{ TEXT("Copy Selection as Spaces"), copySelectionAsSpaces, 0, false, nullptr },
 	{ TEXT(""), nullptr, 0, false, nullptr }, // separator
 	{ TEXT("Settings..."), editSettings, 0, false, nullptr },
+	{ TEXT("Status..."), showStatus, 0, false, nullptr },
+	{ TEXT("Latency..."), showLatency, 0, false, nullptr },
+#ifdef DEBUG_TOOLS
+	{ TEXT("Generate Benchmark Documents"), generateBenchmarkDocuments, 0, false, nullptr },
+	{ TEXT("Run Benchmarks"), runBenchmarks, 0, false, nullptr },
+	{ TEXT("Save Benchmark Results as Baseline"), saveBenchmarkBaseline, 0, false, nullptr },
+	{ TEXT("Check Incremental Recompute"), checkIncrementalRecompute, 0, false, nullptr },
+	{ TEXT("Replay Recording"), replayRecording, 0, false, nullptr },
+#endif
 	{ TEXT("About..."), showAbout, 0, false, nullptr }
 };
 
@@ -56,32 +95,136 @@ static HWND getCurrentScintilla() {
 	else return nppData._scintillaSecondHandle;
 }
 
-std::string ws2s(const std::wstring& wstr)
-{
-	using convert_typeX = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_typeX, wchar_t> converterX;
+// What applies to each buffer, cached so switching between buffers doesn't need to look at the file name
+struct BufferVerdict {
+	bool enabled;
+	char separator;
+};
+
+static std::unordered_map<uptr_t, BufferVerdict> bufferVerdicts;
+
+// Buffers that were opened but haven't been shown yet
+static std::unordered_set<uptr_t> openedBuffers;
 
-	return converterX.to_bytes(wstr);
+// The Scintilla document of each buffer that has been shown, so the engine can forget it when it is closed
+static std::unordered_map<uptr_t, sptr_t> bufferDocuments;
+
+static bool wantsLayoutSnapshot() {
+	return config.layout_snapshot_size > 0 && (size_t)SendMessage(getCurrentScintilla(), SCI_GETLENGTH, 0, 0) >= config.layout_snapshot_size;
 }
 
-static bool shouldProcessCurrentFile() {
+// Where the layout of the current file is kept between sessions
+static std::wstring getLayoutSnapshotPath() {
+	wchar_t path[MAX_PATH] = { 0 };
+	SendMessage(nppData._nppHandle, NPPM_GETFULLCURRENTPATH, MAX_PATH, (LPARAM)path);
+
+	wchar_t fileName[64];
+	swprintf(fileName, 64, L"ElasticTabstopsLayout-%016llx.bin", (unsigned long long)std::hash<std::wstring>()(path));
+	return GetConfigFilePath(&nppData, fileName);
+}
+
+// How many snapshots are kept, the ones written longest ago are deleted first
+#define MAX_LAYOUT_SNAPSHOTS 16
+
+static void saveLayoutSnapshot() {
+	ElasticTabstopsSaveSnapshot(getLayoutSnapshotPath());
+
+	std::vector<std::pair<ULONGLONG, std::wstring>> snapshots;
+	WIN32_FIND_DATAW data;
+	HANDLE find = FindFirstFileW(GetConfigFilePath(&nppData, L"ElasticTabstopsLayout-*.bin").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE) return;
+	do {
+		snapshots.emplace_back(((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime, data.cFileName);
+	} while (FindNextFileW(find, &data));
+	FindClose(find);
+
+	if (snapshots.size() <= MAX_LAYOUT_SNAPSHOTS) return;
+
+	std::sort(snapshots.begin(), snapshots.end(), [](const std::pair<ULONGLONG, std::wstring> &a, const std::pair<ULONGLONG, std::wstring> &b) { return a.first > b.first; });
+	for (size_t i = MAX_LAYOUT_SNAPSHOTS; i < snapshots.size(); i++) {
+		DeleteFileW(GetConfigFilePath(&nppData, snapshots[i].second.c_str()).c_str());
+	}
+}
+
+static const BufferVerdict &getCurrentBufferVerdict() {
+	uptr_t bufferId = (uptr_t)SendMessage(nppData._nppHandle, NPPM_GETCURRENTBUFFERID, 0, 0);
+
+	auto it = bufferVerdicts.find(bufferId);
+	if (it != bufferVerdicts.end()) return it->second;
+
 	// Check the file extension
 	wchar_t buffer[MAX_PATH] = { 0 };
 	SendMessage(nppData._nppHandle, NPPM_GETEXTPART, MAX_PATH, (LPARAM)buffer);
-	std::wstring wext(buffer);
-	std::string ext = ws2s(wext);
+	std::wstring ext(buffer);
 
-	for (const auto &extension: config.file_extensions) {
-		if (extension == "*") return true;
-		if (extension == "!*") return false;
+	BufferVerdict verdict = { config.default_verdict, '\t' };
 
-		bool not = extension[0] == '!';
-		if (extension.compare(not ? 1 : 0, std::string::npos, ext) == 0) {
-			return !not;
-		}
+	auto extension = config.extension_verdicts.find(ext);
+	if (extension != config.extension_verdicts.end()) verdict.enabled = extension->second;
+
+	auto separator = config.extension_separators.find(ext);
+	if (separator != config.extension_separators.end()) verdict.separator = separator->second;
+
+	return bufferVerdicts.emplace(bufferId, verdict).first->second;
+}
+
+static bool shouldProcessCurrentFile() {
+	return getCurrentBufferVerdict().enabled;
+}
+
+static char getSeparatorForCurrentFile() {
+	return getCurrentBufferVerdict().separator;
+}
+
+static const char *getNotificationName(unsigned int code) {
+	switch (code) {
+		case SCN_UPDATEUI: return "SCN_UPDATEUI";
+		case SCN_MODIFIED: return "SCN_MODIFIED";
+		case SCN_ZOOM: return "SCN_ZOOM";
+		case NPPN_READY: return "NPPN_READY";
+		case NPPN_LANGCHANGED: return "NPPN_LANGCHANGED";
+		case NPPN_BUFFERACTIVATED: return "NPPN_BUFFERACTIVATED";
+		case NPPN_FILESAVED: return "NPPN_FILESAVED";
+		case NPPN_FILEOPENED: return "NPPN_FILEOPENED";
+		case NPPN_FILEBEFORECLOSE: return "NPPN_FILEBEFORECLOSE";
+		default: return nullptr;
+	}
+}
+
+static void updateTracing() {
+	if (config.trace) TraceStart(GetConfigFilePath(&nppData, L"ElasticTabstopsTrace.json"));
+	else TraceStop();
+}
+
+static void updateRecording() {
+	if (config.record) {
+		int langType = L_TEXT;
+		SendMessage(nppData._nppHandle, NPPM_GETCURRENTLANGTYPE, 0, (LPARAM)&langType);
+		RecordingStart(GetConfigFilePath(&nppData, L"ElasticTabstopsRecording.bin"), getCurrentScintilla(), langType);
+	}
+	else {
+		RecordingStop();
 	}
+}
 
-	return false;
+// Only what the plugin acts on is recorded. Switching documents always is, so the replay has the right text
+static void recordNotification(const SCNotification *notify, bool isActive) {
+	switch (notify->nmhdr.code) {
+		case SCN_UPDATEUI:
+		case SCN_MODIFIED:
+		case SCN_ZOOM:
+			if (isActive && notify->nmhdr.hwndFrom == getCurrentScintilla()) {
+				RecordingAdd(notify, (HWND)notify->nmhdr.hwndFrom, 0);
+			}
+			break;
+		case NPPN_BUFFERACTIVATED:
+		case NPPN_LANGCHANGED: {
+			int langType = L_TEXT;
+			SendMessage(nppData._nppHandle, NPPM_GETCURRENTLANGTYPE, 0, (LPARAM)&langType);
+			RecordingAdd(notify, getCurrentScintilla(), langType);
+			break;
+		}
+	}
 }
 
 BOOL APIENTRY DllMain(HANDLE hModule, DWORD  reasonForCall, LPVOID lpReserved) {
@@ -116,11 +259,16 @@ extern "C" __declspec(dllexport) FuncItem * getFuncsArray(int *nbF) {
 extern "C" __declspec(dllexport) void beNotified(SCNotification *notify) {
 	static bool isFileEnabled = true;
 	static int numEdits = 0;
+	static bool recomputeView = false; // Something changed that can't be narrowed down to the edits
+	static bool inUndoRedo = false;
 	static struct {
 		int start;
 		int end;
 		int linesAdded;
-		bool hasTab;
+		bool hasSeparator;
+		int firstLine; // Lines spanned by all the edits
+		int lastLine;
+		bool withinLines; // None of the edits added lines or tabs
 	} edit;
 
 	// Somehow we are getting notifications from other scintilla handles at times
@@ -129,39 +277,119 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notify) {
 		notify->nmhdr.hwndFrom != nppData._scintillaSecondHandle)
 		return;
 
+	TraceScope trace(getNotificationName(notify->nmhdr.code));
+
+	if (RecordingEnabled) recordNotification(notify, config.enabled && isFileEnabled);
+
 	switch (notify->nmhdr.code) {
 		case SCN_UPDATEUI:
 			if (!config.enabled || !isFileEnabled) break;
 
-			if (notify->updated & SC_UPDATE_V_SCROLL || numEdits > 0) {
+			if (notify->updated & SC_UPDATE_V_SCROLL || numEdits > 0 || recomputeView) {
+				LatencyScope latency(numEdits > 0 || recomputeView ? LATENCY_EDIT : LATENCY_SCROLL);
+
 				// A single "edit" can be optimized to potentially update a smaller area
 				// More than 1 is easiest to just update the current view
-				if (numEdits == 1) {
-					ElasticTabstopsOnModify(edit.start, edit.end, edit.linesAdded, edit.hasTab);
+				if (recomputeView) {
+					ElasticTabstopsComputeCurrentView();
+				}
+				else if (numEdits == 1) {
+					ElasticTabstopsOnModify(edit.start, edit.end, edit.linesAdded, edit.hasSeparator);
+				}
+				else if (numEdits > 1 && edit.withinLines) {
+					// Multiple carets or a rectangular selection, the same cells changed on a range of lines
+					ElasticTabstopsOnModifyColumn(edit.firstLine, edit.lastLine, numEdits);
+				}
+				else if (numEdits == 0) {
+					// Just scrolled, most of what comes into view has been computed ahead of time
+					ElasticTabstopsOnScroll();
 				}
 				else {
 					ElasticTabstopsComputeCurrentView();
 				}
 
 				numEdits = 0;
+				recomputeView = false;
+			}
+			else {
+				// Text can be restyled without being edited, such as changing the language
+				ElasticTabstopsComputeRestyled();
 			}
 
 			break;
 		case SCN_MODIFIED: {
-			if (!config.enabled || !isFileEnabled) break;
+			if (!config.enabled) {
+				// Whichever document it was, it's cheaper to measure again than to find out
+				if (notify->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) ElasticTabstopsDropSuspended();
+				break;
+			}
+			if (!isFileEnabled) break;
 
 			bool isInsert = (notify->modificationType & SC_MOD_INSERTTEXT) != 0;
 			bool isDelete = (notify->modificationType & SC_MOD_DELETETEXT) != 0;
 
+			// Both views are notified when they show the same document, only the current one is computed.
+			// Edits in the other view just move the tabstops kept for its own document.
+			if (notify->nmhdr.hwndFrom != getCurrentScintilla()) {
+				if ((isInsert || isDelete) && notify->linesAdded != 0) {
+					HWND other = (HWND)notify->nmhdr.hwndFrom;
+					int line = static_cast<int>(SendMessage(other, SCI_LINEFROMPOSITION, notify->position, 0));
+					ElasticTabstopsOnDocumentLinesChanged(SendMessage(other, SCI_GETDOCPOINTER, 0, 0), line, static_cast<int>(notify->linesAdded));
+				}
+				break;
+			}
+
+			if (notify->modificationType & SC_MOD_CHANGESTYLE) {
+				ElasticTabstopsOnStyleChanged(static_cast<int>(notify->position), static_cast<int>(notify->length));
+			}
+
+			// Restyling while scrolling isn't an edit, everything below is part of the update the edit leads to
+			if (!isInsert && !isDelete && !inUndoRedo) break;
+			LatencyScope latency(LATENCY_EDIT, true);
+
 			// Make sure we only look at inserts and deletes
 			if (isInsert || isDelete) {
+				// Undoing or redoing several steps at once is gathered up and handled as one edit on the last step
+				if ((notify->modificationType & SC_MULTISTEPUNDOREDO) && !inUndoRedo) {
+					inUndoRedo = true;
+					ElasticTabstopsBeginLinesChanged();
+				}
+
+				// Keep track of where the lines with tabstops went for every edit, not just the first
+				ElasticTabstopsOnLinesChanged(static_cast<int>(notify->position), static_cast<int>(notify->linesAdded));
+			}
+
+			if (inUndoRedo) {
+				if (notify->modificationType & SC_LASTSTEPINUNDOREDO) {
+					inUndoRedo = false;
+					ElasticTabstopsEndLinesChanged();
+
+					// Recompute the view once for the whole undo or redo
+					recomputeView = true;
+				}
+			}
+			else if (isInsert || isDelete) {
+				const char separator = getSeparatorForCurrentFile();
+				// The text isn't null terminated. In quoted files a quote can turn the separators after it into text and back
+				bool hasSeparator = notify->text && (memchr(notify->text, separator, notify->length) != NULL ||
+					(separator != '\t' && config.quoted_separators && memchr(notify->text, '"', notify->length) != NULL));
+				int line = static_cast<int>(SendMessage((HWND)notify->nmhdr.hwndFrom, SCI_LINEFROMPOSITION, notify->position, 0));
+
 				numEdits++;
 				if (numEdits == 1) {
 					edit.start = static_cast<int>(notify->position);
 					edit.end = static_cast<int>((isInsert ? notify->position + notify->length : notify->position));
 					edit.linesAdded = static_cast<int>(notify->linesAdded);
-					edit.hasTab = notify->text && strchr(notify->text, '\t') != NULL;
+					edit.hasSeparator = hasSeparator;
+					edit.firstLine = line;
+					edit.lastLine = line;
+					edit.withinLines = true;
+				}
+				else {
+					edit.firstLine = __min(edit.firstLine, line);
+					edit.lastLine = __max(edit.lastLine, line);
 				}
+				edit.withinLines = edit.withinLines && notify->linesAdded == 0 && !hasSeparator;
 			}
 
 			break;
@@ -169,45 +397,119 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notify) {
 		case SCN_ZOOM: {
 			if (!config.enabled || !isFileEnabled) break;
 
+			LatencyScope latency(LATENCY_ZOOM);
+
 			// Redo the current view since the tab sizes have changed
 			ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
 			ElasticTabstopsComputeCurrentView();
 
 			break;
 		}
+		case NPPN_WORDSTYLESUPDATED:
+			// The fonts might have changed
+			ElasticTabstopsDropSuspended();
+			ElasticTabstopsDropWidths();
+			if (!config.enabled || !isFileEnabled) break;
+
+			ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
+			ElasticTabstopsComputeCurrentView();
+			break;
+		case NPPN_LANGCHANGED:
+			if (!config.enabled) ElasticTabstopsDropSuspended();
+
+			// The styles have different fonts now, so the widths measured with the old ones are no use
+			ElasticTabstopsDropWidths();
+			if (!config.enabled || !isFileEnabled) break;
+
+			ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
+			ElasticTabstopsComputeCurrentView();
+			break;
 		case NPPN_READY:
+			updateTracing();
+			updateRecording();
 			CheckMenuItem(GetMenu(nppData._nppHandle), funcItem[0]._cmdID, config.enabled ? MF_CHECKED : MF_UNCHECKED);
 			ElasticTabstopsOnReady(nppData._scintillaMainHandle);
 			ElasticTabstopsOnReady(nppData._scintillaSecondHandle);
+			ElasticTabstopsLoadFontMetrics(GetConfigFilePath(&nppData, L"ElasticTabstopsFontMetrics.bin"));
+			ElasticTabstopsSetSeparator(getSeparatorForCurrentFile(), config.quoted_separators);
 			ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
 			if (config.enabled) ElasticTabstopsComputeCurrentView();
 			break;
 		case NPPN_SHUTDOWN:
+			TraceStop();
+			RecordingStop();
 			ConfigSave(&nppData, &config);
+			ElasticTabstopsSaveFontMetrics(GetConfigFilePath(&nppData, L"ElasticTabstopsFontMetrics.bin"));
 			break;
 		case NPPN_BUFFERACTIVATED:
+			bufferDocuments[notify->nmhdr.idFrom] = SendMessage(getCurrentScintilla(), SCI_GETDOCPOINTER, 0, 0);
 			if (!config.enabled) break;
 
 			isFileEnabled = shouldProcessCurrentFile();
 
 			if (isFileEnabled) {
+				LatencyScope latency(LATENCY_BUFFER_ACTIVATED);
+
+				ElasticTabstopsSetSeparator(getSeparatorForCurrentFile(), config.quoted_separators);
 				ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
+
+				// The first time a file is shown its layout might have been kept from an earlier session
+				if (openedBuffers.erase(notify->nmhdr.idFrom) && wantsLayoutSnapshot()) {
+					ElasticTabstopsLoadSnapshot(getLayoutSnapshotPath());
+				}
+
 				ElasticTabstopsComputeCurrentView();
 				numEdits = 0;
+				recomputeView = false;
 			}
 
+			break;
+		case NPPN_FILEOPENED:
+			openedBuffers.insert(notify->nmhdr.idFrom);
+			break;
+		case NPPN_FILEBEFORECLOSE: {
+			// Only the current file's layout is known, and only if it matches what is on disk
+			if (config.enabled && isFileEnabled &&
+				notify->nmhdr.idFrom == (uptr_t)SendMessage(nppData._nppHandle, NPPM_GETCURRENTBUFFERID, 0, 0) &&
+				!SendMessage(getCurrentScintilla(), SCI_GETMODIFY, 0, 0) && wantsLayoutSnapshot()) {
+				saveLayoutSnapshot();
+			}
+
+			auto document = bufferDocuments.find(notify->nmhdr.idFrom);
+			if (document != bufferDocuments.end()) {
+				ElasticTabstopsForgetDocument(document->second);
+				bufferDocuments.erase(document);
+			}
+			break;
+		}
+		case NPPN_FILERENAMED:
+		case NPPN_FILECLOSED:
+			// Forget the buffer, if it is still open its extension might have changed
+			bufferVerdicts.erase(notify->nmhdr.idFrom);
+			openedBuffers.erase(notify->nmhdr.idFrom);
 			break;
 		case NPPN_FILESAVED: {
+			// Saving as a different name can change the extension
+			bufferVerdicts.erase(notify->nmhdr.idFrom);
+
 			wchar_t fname[MAX_PATH] = { 0 };
 			SendMessage(nppData._nppHandle, NPPM_GETFULLPATHFROMBUFFERID, notify->nmhdr.idFrom, (LPARAM)fname);
 			if (wcscmp(fname, GetIniFilePath(&nppData)) == 0) {
 				ConfigLoad(&nppData, &config);
+				bufferVerdicts.clear();
+				updateTracing();
+				updateRecording();
 				CheckMenuItem(GetMenu(nppData._nppHandle), funcItem[0]._cmdID, config.enabled ? MF_CHECKED : MF_UNCHECKED);
 
 				// Immediately apply the new config to the config file itself
+				ElasticTabstopsSetSeparator(getSeparatorForCurrentFile(), config.quoted_separators);
 				ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
 				ElasticTabstopsComputeCurrentView();
 			}
+			else if (config.enabled && isFileEnabled && wantsLayoutSnapshot() &&
+				notify->nmhdr.idFrom == (uptr_t)SendMessage(nppData._nppHandle, NPPM_GETCURRENTBUFFERID, 0, 0)) {
+				saveLayoutSnapshot();
+			}
 			break;
 		}
 	}
@@ -215,6 +517,15 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notify) {
 }
 
 extern "C" __declspec(dllexport) LRESULT messageProc(UINT Message, WPARAM wParam, LPARAM lParam) {
+	// Other plugins asking about the layout, see ElasticTabstopsMsgs.h
+	if (Message == NPPM_MSGTOPLUGIN) {
+		const CommunicationInfo *info = reinterpret_cast<const CommunicationInfo *>(lParam);
+
+		// The engine keeps the layout of the last file it was enabled for, not necessarily the current one
+		if (info->internalMsg != ETM_GETVERSION && (!config.enabled || !shouldProcessCurrentFile())) return FALSE;
+		return ElasticTabstopsQuery(info->internalMsg, info->info);
+	}
+
 	return TRUE;
 }
 
@@ -226,23 +537,28 @@ static void toggleEnabled() {
 	config.enabled = !config.enabled;
 	SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, funcItem[0]._cmdID, config.enabled);
 
+	// Buffers may have been switched while disabled
+	ElasticTabstopsSetSeparator(getSeparatorForCurrentFile(), config.quoted_separators);
+	ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
+
 	if (config.enabled && shouldProcessCurrentFile()) {
-		// Run it on the current file
+		// Run it on the current file, what was in view when it was disabled is put back if nothing changed
 		ElasticTabstopsComputeCurrentView();
 	}
+	else if (!config.enabled) {
+		// Clear the tabstops on the lines that have them, keeping them for when it is enabled again
+		ElasticTabstopsSuspend();
+	}
 	else {
-		// Clear all tabstops on the file
-		HWND sci = getCurrentScintilla();
-		auto lineCount = SendMessage(sci, SCI_GETLINECOUNT, 0, 0);
-		for (auto i = 0; i < lineCount; ++i) {
-			SendMessage(sci, SCI_CLEARTABSTOPS, i, 0);
-		}
+		ElasticTabstopsClearTabstops();
 	}
 }
 
 static void convertEtToSpaces() {
 	if (!config.enabled || !shouldProcessCurrentFile()) return;
 
+	LatencyScope latency(LATENCY_CONVERSION);
+
 	// Temporarily disable elastic tabstops because replacing tabs with spaces causes
 	// Scintilla to send notifications of all the changes.
 	config.enabled = false;
@@ -250,11 +566,179 @@ static void convertEtToSpaces() {
 	config.enabled = true;
 }
 
+static void convertSpacesToEt() {
+	if (!config.enabled || !shouldProcessCurrentFile()) return;
+
+	LatencyScope latency(LATENCY_CONVERSION);
+
+	// Same as above, then compute the new tabstops once everything is converted
+	config.enabled = false;
+	ElasticTabstopsConvertToTabs();
+	config.enabled = true;
+
+	ElasticTabstopsComputeCurrentView();
+}
+
+static void convertSelectionToSpaces() {
+	if (!config.enabled || !shouldProcessCurrentFile()) return;
+
+	LatencyScope latency(LATENCY_CONVERSION);
+
+	// Same as converting the whole file, the lines around the selection still have their tabs though
+	config.enabled = false;
+	ElasticTabstopsConvertSelectionToSpaces(&config);
+	config.enabled = true;
+
+	ElasticTabstopsComputeCurrentView();
+}
+
+static void copySelectionAsSpaces() {
+	if (!config.enabled || !shouldProcessCurrentFile()) return;
+
+	LatencyScope latency(LATENCY_CONVERSION);
+
+	ElasticTabstopsCopySelectionAsSpaces(&config);
+}
+
 static void editSettings() {
 	ConfigSave(&nppData, &config);
 	SendMessage(nppData._nppHandle, NPPM_DOOPEN, 0, (LPARAM)GetIniFilePath(&nppData));
 }
 
+static void showStatus() {
+	std::string status = ElasticTabstopsGetStatus();
+	MessageBox(nppData._nppHandle, std::wstring(status.begin(), status.end()).c_str(), NPP_PLUGIN_NAME, MB_OK | MB_ICONINFORMATION);
+}
+
+static void showLatency() {
+	std::string report = LatencyReport() + "\nReset the measurements?";
+	if (MessageBox(nppData._nppHandle, std::wstring(report.begin(), report.end()).c_str(), NPP_PLUGIN_NAME, MB_YESNO | MB_ICONINFORMATION) == IDYES) {
+		LatencyReset();
+	}
+}
+
+#ifdef DEBUG_TOOLS
+static void generateBenchmarkDocuments() {
+	// Open each of the documents the benchmarks use in a new tab
+	for (size_t i = 0; i < CorpusPresetCount; ++i) {
+		std::string text = CorpusGenerate(&CorpusPresets[i]);
+
+		SendMessage(nppData._nppHandle, NPPM_MENUCOMMAND, 0, IDM_FILE_NEW);
+		SendMessage(getCurrentScintilla(), SCI_SETTEXT, 0, (LPARAM)text.c_str());
+	}
+}
+
+// Runs the function in a scratch document, ignoring any notifications so only its own calls do any work
+template<typename F>
+static std::string runInScratchDocument(F f) {
+	bool enabled = config.enabled;
+	config.enabled = false;
+
+	SendMessage(nppData._nppHandle, NPPM_MENUCOMMAND, 0, IDM_FILE_NEW);
+	HWND sci = getCurrentScintilla();
+	std::string report = f(sci);
+	SendMessage(sci, SCI_SETSAVEPOINT, 0, 0);
+	SendMessage(nppData._nppHandle, NPPM_MENUCOMMAND, 0, IDM_FILE_CLOSE);
+
+	config.enabled = enabled;
+	ElasticTabstopsSetSeparator(getSeparatorForCurrentFile(), config.quoted_separators);
+	if (config.enabled && shouldProcessCurrentFile()) {
+		ElasticTabstopsSwitchToScintilla(getCurrentScintilla(), &config);
+		ElasticTabstopsComputeCurrentView();
+	}
+
+	return report;
+}
+
+// The baseline committed with the source is built in, one saved to the config directory overrides it
+static std::string getBenchmarkBaseline() {
+	std::string baseline;
+
+	FILE *file = _wfopen(GetConfigFilePath(&nppData, L"ElasticTabstopsBenchmarkBaseline.json").c_str(), L"rb");
+	if (file != nullptr) {
+		char buffer[4096];
+		size_t length;
+		while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) baseline.append(buffer, length);
+		fclose(file);
+		return baseline;
+	}
+
+	HRSRC resource = FindResource((HMODULE)_hModule, MAKEINTRESOURCE(IDR_BENCHMARK_BASELINE), RT_RCDATA);
+	if (resource != nullptr) {
+		baseline.assign((const char *)LockResource(LoadResource((HMODULE)_hModule, resource)), SizeofResource((HMODULE)_hModule, resource));
+	}
+	return baseline;
+}
+
+static void runBenchmarks() {
+	const std::string baseline = getBenchmarkBaseline();
+	bool passed = false;
+	std::string report = runInScratchDocument([&baseline, &passed](HWND sci) {
+		return BenchmarkRun(sci, &config, GetConfigFilePath(&nppData, L"ElasticTabstopsBenchmark.json"), baseline, &passed);
+	});
+
+	MessageBox(nppData._nppHandle, std::wstring(report.begin(), report.end()).c_str(), NPP_PLUGIN_NAME, MB_OK | (passed ? MB_ICONINFORMATION : MB_ICONERROR));
+}
+
+static void saveBenchmarkBaseline() {
+	CopyFileW(GetConfigFilePath(&nppData, L"ElasticTabstopsBenchmark.json").c_str(), GetConfigFilePath(&nppData, L"ElasticTabstopsBenchmarkBaseline.json").c_str(), FALSE);
+}
+
+static void checkIncrementalRecompute() {
+	// A new seed each time, the report includes it so a divergence can be reproduced
+	unsigned int seed = GetTickCount();
+	bool passed = false;
+	std::string report = runInScratchDocument([seed, &passed](HWND sci) {
+		return IncrementalCheckRun(ScintillaEditor(sci), &config, seed, 20, &passed);
+	});
+
+	MessageBox(nppData._nppHandle, std::wstring(report.begin(), report.end()).c_str(), NPP_PLUGIN_NAME, MB_OK | (passed ? MB_ICONINFORMATION : MB_ICONERROR));
+}
+
+// Replays ElasticTabstopsRecording.bin in a scratch document, see ReplayRun for how.
+static void replayRecording() {
+	// The file isn't complete until recording stops, and the replay shouldn't record itself
+	RecordingStop();
+
+	std::vector<RecordedNotification> notifications;
+	if (!RecordingLoad(GetConfigFilePath(&nppData, L"ElasticTabstopsRecording.bin"), notifications)) {
+		MessageBox(nppData._nppHandle, L"ElasticTabstopsRecording.bin could not be loaded", NPP_PLUGIN_NAME, MB_OK | MB_ICONWARNING);
+		return;
+	}
+
+	std::string report = runInScratchDocument([&notifications](HWND sci) {
+		// The replay isn't the user's latency
+		config.enabled = true;
+		LatencyEnabled = false;
+
+		std::string report = ReplayRun(ScintillaEditor(sci), notifications, [sci](SCNotification *notify, const RecordedNotification &recorded) {
+			notify->nmhdr.hwndFrom = sci;
+
+			switch (recorded.code) {
+				case NPPN_BUFFERACTIVATED:
+				case NPPN_LANGCHANGED:
+					notify->nmhdr.hwndFrom = nppData._nppHandle;
+					notify->nmhdr.idFrom = SendMessage(nppData._nppHandle, NPPM_GETCURRENTBUFFERID, 0, 0);
+					SendMessage(nppData._nppHandle, NPPM_SETCURRENTLANGTYPE, 0, recorded.langType);
+					break;
+				case SCN_ZOOM:
+					// The editor notifies zooming by itself
+					SendMessage(sci, SCI_SETZOOM, recorded.zoom, 0);
+					return;
+			}
+
+			beNotified(notify);
+		});
+
+		LatencyEnabled = true;
+		config.enabled = false;
+		return report;
+	});
+
+	MessageBox(nppData._nppHandle, std::wstring(report.begin(), report.end()).c_str(), NPP_PLUGIN_NAME, MB_OK | MB_ICONINFORMATION);
+}
+#endif
+
 static void showAbout() {
 	ShowAboutDialog((HINSTANCE)_hModule, MAKEINTRESOURCE(IDD_ABOUTDLG), nppData._nppHandle);
 }
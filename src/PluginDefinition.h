@@ -23,3 +23,8 @@
 #define SCI_UNUSED 0
 
 const wchar_t NPP_PLUGIN_NAME[] = TEXT("Elastic Tabstops");
+
+// Profile builds are optimized like release builds but keep the debugging tools
+#if defined(_DEBUG) || defined(PROFILE)
+#define DEBUG_TOOLS
+#endif
@@ -0,0 +1,127 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <stdio.h>
+#include <cstdint>
+#include "Recording.h"
+
+static_assert(REPLAY_BUFFERACTIVATED == NPPN_BUFFERACTIVATED && REPLAY_LANGCHANGED == NPPN_LANGCHANGED, "Replaying switches documents on the wrong codes");
+
+bool RecordingEnabled = false;
+
+static FILE *file = nullptr;
+static LARGE_INTEGER frequency;
+static LARGE_INTEGER start_time;
+
+static void write(const recording_header &header, const char *text) {
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	recording_header timed = header;
+	timed.timestamp = (now.QuadPart - start_time.QuadPart) * 1000000 / frequency.QuadPart;
+
+	fwrite(&timed, sizeof(timed), 1, file);
+	if (timed.text_length > 0) fwrite(text, 1, timed.text_length, file);
+}
+
+static recording_header get_editor_state(HWND sci, int langType) {
+	recording_header header = {};
+	header.first_visible_line = (int32_t)SendMessage(sci, SCI_GETFIRSTVISIBLELINE, 0, 0);
+	header.zoom = (int32_t)SendMessage(sci, SCI_GETZOOM, 0, 0);
+	header.lang_type = langType;
+	return header;
+}
+
+// The whole document, so replaying starts from the same text
+static void write_document(recording_header &header, HWND sci) {
+	const char *text = (const char *)SendMessage(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+	header.text_length = (uint32_t)SendMessage(sci, SCI_GETLENGTH, 0, 0);
+	write(header, text);
+}
+
+void RecordingStart(const std::wstring &path, HWND sci, int langType) {
+	if (RecordingEnabled) return;
+
+	file = _wfopen(path.c_str(), L"wb");
+	if (file == nullptr) return;
+
+	const uint32_t magic[] = { RECORDING_MAGIC, RECORDING_VERSION };
+	fwrite(magic, sizeof(magic), 1, file);
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start_time);
+	RecordingEnabled = true;
+
+	// Start off as if the current document had just been switched to
+	recording_header header = get_editor_state(sci, langType);
+	header.code = NPPN_BUFFERACTIVATED;
+	write_document(header, sci);
+}
+
+void RecordingStop() {
+	if (!RecordingEnabled) return;
+
+	fclose(file);
+	file = nullptr;
+	RecordingEnabled = false;
+}
+
+void RecordingAdd(const SCNotification *notify, HWND sci, int langType) {
+	if (!RecordingEnabled) return;
+
+	recording_header header = get_editor_state(sci, langType);
+	header.code = notify->nmhdr.code;
+
+	switch (notify->nmhdr.code) {
+		case SCN_MODIFIED:
+			header.modification_type = notify->modificationType;
+			header.position = notify->position;
+			header.length = notify->length;
+			header.lines_added = (int32_t)notify->linesAdded;
+
+			// Deletes only need the range, the text is already in the document being replayed
+			if ((notify->modificationType & SC_MOD_INSERTTEXT) && notify->text != nullptr) {
+				header.text_length = (uint32_t)notify->length;
+				write(header, notify->text);
+			}
+			else {
+				write(header, nullptr);
+			}
+			break;
+		case SCN_UPDATEUI:
+			header.updated = notify->updated;
+			write(header, nullptr);
+			break;
+		case NPPN_BUFFERACTIVATED:
+			write_document(header, sci);
+			break;
+		default:
+			write(header, nullptr);
+			break;
+	}
+}
+
+bool RecordingLoad(const std::wstring &path, std::vector<RecordedNotification> &notifications) {
+	FILE *recording = _wfopen(path.c_str(), L"rb");
+	if (recording == nullptr) return false;
+
+	const bool valid = ReplayLoad(recording, notifications);
+
+	fclose(recording);
+	return valid;
+}
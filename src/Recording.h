@@ -0,0 +1,33 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "PluginInterface.h"
+#include "Replay.h"
+
+// Records the notifications the plugin gets, along with the documents they were for, so a session
+// can be replayed and benchmarked somewhere else. Nothing is recorded unless recording has been started.
+extern bool RecordingEnabled;
+
+void RecordingStart(const std::wstring &path, HWND sci, int langType);
+void RecordingStop();
+void RecordingAdd(const SCNotification *notify, HWND sci, int langType);
+bool RecordingLoad(const std::wstring &path, std::vector<RecordedNotification> &notifications);
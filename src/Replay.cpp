@@ -0,0 +1,132 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include "Replay.h"
+
+struct replay_timing {
+	size_t count;
+	double total;
+	double max;
+};
+
+static const char *get_notification_name(unsigned int code) {
+	switch (code) {
+		case SCN_UPDATEUI: return "SCN_UPDATEUI";
+		case SCN_MODIFIED: return "SCN_MODIFIED";
+		case SCN_ZOOM: return "SCN_ZOOM";
+		case REPLAY_BUFFERACTIVATED: return "NPPN_BUFFERACTIVATED";
+		case REPLAY_LANGCHANGED: return "NPPN_LANGCHANGED";
+		default: return "Other";
+	}
+}
+
+bool ReplayLoad(FILE *file, std::vector<RecordedNotification> &notifications) {
+	uint32_t magic[2];
+	bool valid = fread(magic, sizeof(magic), 1, file) == 1 && magic[0] == RECORDING_MAGIC && magic[1] == RECORDING_VERSION;
+
+	// A recording that was cut short (e.g. Notepad++ crashed) is still good up to where it stops
+	recording_header header;
+	while (valid && fread(&header, sizeof(header), 1, file) == 1) {
+		RecordedNotification notification = {
+			header.code, header.modification_type, header.updated, header.lines_added,
+			header.position, header.length, header.first_visible_line, header.zoom, header.lang_type,
+			header.timestamp, std::string(header.text_length, '\0')
+		};
+
+		if (header.text_length > 0 && fread(&notification.text[0], 1, header.text_length, file) != header.text_length) break;
+
+		notifications.push_back(std::move(notification));
+	}
+
+	return valid;
+}
+
+std::string ReplayRun(const ScintillaEditor &editor, const std::vector<RecordedNotification> &notifications, const ReplayHandler &handler) {
+	std::map<std::string, replay_timing> timings;
+
+	const int eventMask = editor.GetModEventMask();
+	const int zoom = editor.GetZoom();
+
+	for (const auto &recorded : notifications) {
+		SCNotification notify = {};
+		std::string deleted;
+		notify.nmhdr.code = recorded.code;
+
+		// Changing the document would notify the handler itself
+		editor.SetModEventMask(0);
+
+		switch (recorded.code) {
+			case REPLAY_BUFFERACTIVATED:
+				editor.SetZoom(recorded.zoom);
+				editor.ClearAll();
+				editor.AppendText(recorded.text);
+				editor.EmptyUndoBuffer();
+				break;
+			case SCN_MODIFIED:
+				notify.modificationType = recorded.modificationType;
+				notify.position = (Sci_Position)recorded.position;
+				notify.length = (Sci_Position)recorded.length;
+				notify.linesAdded = recorded.linesAdded;
+
+				if (recorded.modificationType & SC_MOD_INSERTTEXT) {
+					editor.SetTargetRange((int)recorded.position, (int)recorded.position);
+					editor.ReplaceTarget(recorded.text);
+					notify.text = recorded.text.data();
+				}
+				else if (recorded.modificationType & SC_MOD_DELETETEXT) {
+					// Scintilla hands on the deleted text too, it is needed to tell if a separator was deleted
+					deleted.assign(editor.GetCharacterPointer() + recorded.position, (size_t)recorded.length);
+					editor.DeleteRange((int)recorded.position, (int)recorded.length);
+					notify.text = deleted.data();
+				}
+				break;
+			case SCN_UPDATEUI:
+				notify.updated = recorded.updated;
+				break;
+		}
+
+		editor.SetModEventMask(eventMask);
+		editor.SetFirstVisibleLine(recorded.firstVisibleLine);
+
+		// The lexer restyles the replayed text by itself
+		const bool restyleOnly = recorded.code == SCN_MODIFIED && !(recorded.modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT));
+		if (restyleOnly) continue;
+
+		const auto start = std::chrono::steady_clock::now();
+		handler(&notify, recorded);
+		const std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+
+		replay_timing &timing = timings[get_notification_name(recorded.code)];
+		timing.count++;
+		timing.total += ms.count();
+		timing.max = std::max(timing.max, ms.count());
+	}
+
+	editor.SetZoom(zoom);
+
+	std::string report = "Replayed " + std::to_string(notifications.size()) + " notifications\n";
+	for (const auto &timing : timings) {
+		char line[256];
+		snprintf(line, sizeof(line), "\n%s: %zu, %.1f ms total, %.3f ms max", timing.first.c_str(), timing.second.count, timing.second.total, timing.second.max);
+		report += line;
+	}
+	return report;
+}
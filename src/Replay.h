@@ -0,0 +1,74 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <stdio.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "ScintillaEditor.h"
+
+// Replaying only needs Scintilla, so a recording can be replayed outside of Notepad++ and off Windows.
+// The codes are the same as NPPN_BUFFERACTIVATED and NPPN_LANGCHANGED, which need windows.h
+#define REPLAY_BUFFERACTIVATED 1010
+#define REPLAY_LANGCHANGED 1011
+
+struct RecordedNotification {
+	unsigned int code;
+	int modificationType;
+	int updated;
+	int linesAdded;
+	long long position;
+	long long length;
+	int firstVisibleLine; // State of the editor when the notification was sent
+	int zoom;
+	int langType;
+	long long timestamp; // Microseconds since recording started
+	std::string text; // Inserted text, or the whole document when switching to it
+};
+
+// The recording file, each notification is written as is followed by text_length bytes of text
+#define RECORDING_MAGIC 0x43525445 // "ETRC"
+#define RECORDING_VERSION 1
+
+struct recording_header {
+	uint32_t code;
+	int32_t modification_type;
+	int32_t updated;
+	int32_t lines_added;
+	int64_t position;
+	int64_t length;
+	int32_t first_visible_line;
+	int32_t zoom;
+	int32_t lang_type;
+	uint32_t text_length;
+	int64_t timestamp;
+};
+
+// Handles a notification the same way the plugin would. Anything that needs more than the editor, like
+// the language when switching documents, is taken from the recording. SCN_ZOOM is handed on before the
+// zoom changes since in Notepad++ changing it is what sends the notification
+typedef std::function<void(SCNotification *notify, const RecordedNotification &recorded)> ReplayHandler;
+
+bool ReplayLoad(FILE *file, std::vector<RecordedNotification> &notifications);
+
+// Brings the editor's document to the state it was in for each notification before handing it on, so
+// only the handler is timed. The zoom the editor had is put back afterwards.
+std::string ReplayRun(const ScintillaEditor &editor, const std::vector<RecordedNotification> &notifications, const ReplayHandler &handler);
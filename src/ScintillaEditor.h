@@ -34,7 +34,9 @@ typedef int KeyModifier;
 
 class ScintillaEditor final {
 private:
+#ifdef _WIN32
 	HWND scintilla = nullptr;
+#endif
 	SciFnDirect directFunction = nullptr;
 	sptr_t directPointer = 0;
 
@@ -45,6 +47,10 @@ private:
 public:
 	ScintillaEditor() {}
 
+	// Scintilla without a window, e.g. on other platforms, only has its direct function
+	ScintillaEditor(SciFnDirect directFunction, sptr_t directPointer) : directFunction(directFunction), directPointer(directPointer) {}
+
+#ifdef _WIN32
 	explicit ScintillaEditor(HWND scintilla) {
 		SetScintillaInstance(scintilla);
 	}
@@ -58,6 +64,7 @@ public:
 	HWND GetScintillaInstance() const {
 		return scintilla;
 	}
+#endif
 
 	template<typename T = int, typename U = int>
 	inline sptr_t Call(unsigned int message, T wParam = 0, U lParam = 0) const {
@@ -0,0 +1,77 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <stdio.h>
+#include <vector>
+#include "PluginDefinition.h"
+#include "Trace.h"
+
+// Events are buffered and written out in batches to keep the file I/O off the hot path
+#define TRACE_BUFFER_SIZE 4096
+
+struct trace_event {
+	const char *name;
+	char phase;
+	long long timestamp;
+};
+
+bool TraceEnabled = false;
+
+static FILE *file = nullptr;
+static std::vector<trace_event> events;
+static LARGE_INTEGER frequency;
+static LARGE_INTEGER start_time;
+
+static void flush() {
+	for (const auto &event : events) {
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":1},\n", event.name, event.phase, event.timestamp);
+	}
+	events.clear();
+}
+
+void TraceStart(const std::wstring &path) {
+	if (TraceEnabled) return;
+
+	file = _wfopen(path.c_str(), L"w");
+	if (file == nullptr) return;
+
+	// The closing bracket is optional in the JSON array format, which allows a trailing comma as well
+	fputs("[\n", file);
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start_time);
+	events.reserve(TRACE_BUFFER_SIZE);
+	TraceEnabled = true;
+}
+
+void TraceStop() {
+	if (!TraceEnabled) return;
+
+	flush();
+	fclose(file);
+	file = nullptr;
+	TraceEnabled = false;
+}
+
+void TraceEvent(const char *name, char phase) {
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	events.push_back({ name, phase, (now.QuadPart - start_time.QuadPart) * 1000000 / frequency.QuadPart });
+	if (events.size() >= TRACE_BUFFER_SIZE) flush();
+}
@@ -0,0 +1,51 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+
+// Records begin/end events in the Chrome Trace Event format so a session can be loaded in
+// chrome://tracing or Perfetto. Nothing is recorded unless tracing has been started.
+extern bool TraceEnabled;
+
+void TraceStart(const std::wstring &path);
+void TraceStop();
+void TraceEvent(const char *name, char phase);
+
+inline void TraceBegin(const char *name) {
+	if (TraceEnabled) TraceEvent(name, 'B');
+}
+
+inline void TraceEnd(const char *name) {
+	if (TraceEnabled) TraceEvent(name, 'E');
+}
+
+class TraceScope final {
+private:
+	const char *name;
+
+public:
+	explicit TraceScope(const char *name) : name(name) {
+		if (name) TraceBegin(name);
+	}
+
+	~TraceScope() {
+		if (name) TraceEnd(name);
+	}
+};
@@ -3,6 +3,7 @@
 #endif
 
 #define IDD_ABOUTDLG                            101
+#define IDR_BENCHMARK_BASELINE                  102
 #define IDC_GITHUB                              1000
 #define IDC_VERSION                             1001
 #define IDC_README                              1002
@@ -0,0 +1,267 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <algorithm>
+#include "windows.h"
+#include "FakeScintilla.h"
+
+#define FAKE_FONT "Fake Sans"
+#define FAKE_FONT_SIZE 10
+
+FakeScintilla::FakeScintilla(int linesOnScreen) : lines_on_screen(linesOnScreen) {
+	find_line_starts();
+}
+
+sptr_t FakeScintilla::DirectFunction(sptr_t ptr, unsigned int message, uptr_t wParam, sptr_t lParam) {
+	return reinterpret_cast<FakeScintilla *>(ptr)->message(message, wParam, lParam);
+}
+
+// Lines end with CR LF, LF or CR on its own
+void FakeScintilla::find_line_starts() {
+	line_starts.assign(1, 0);
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '\n' || (text[i] == '\r' && (i + 1 == text.size() || text[i + 1] != '\n'))) {
+			line_starts.push_back((int)i + 1);
+		}
+	}
+}
+
+int FakeScintilla::line_from_position(int position) const {
+	return (int)(std::upper_bound(line_starts.begin(), line_starts.end(), position) - line_starts.begin()) - 1;
+}
+
+int FakeScintilla::position_from_line(int line) const {
+	if (line <= 0) return 0;
+	if (line >= (int)line_starts.size()) return (int)text.size();
+	return line_starts[line];
+}
+
+int FakeScintilla::line_end_position(int line) const {
+	int end = position_from_line(line + 1);
+	const int start = position_from_line(line);
+	while (end > start && (text[end - 1] == '\n' || text[end - 1] == '\r')) end--;
+	return end;
+}
+
+// Characters are a whole UTF-8 sequence or DBCS pair, and a line end is a single character
+int FakeScintilla::position_after(int position) const {
+	const int length = (int)text.size();
+	if (position >= length) return length;
+
+	const unsigned char c = (unsigned char)text[position];
+	if (c == '\r' && position + 1 < length && text[position + 1] == '\n') return position + 2;
+	if (code_page == SC_CP_UTF8) {
+		position++;
+		while (position < length && ((unsigned char)text[position] & 0xC0) == 0x80) position++;
+		return position;
+	}
+	if (IsDBCSLeadByteEx(code_page, c)) return __min(position + 2, length);
+	return position + 1;
+}
+
+int FakeScintilla::position_before(int position) const {
+	if (position <= 0) return 0;
+
+	// Walking back over DBCS is ambiguous, so go forward from the start of the line instead
+	const int line_start = position_from_line(line_from_position(position - 1));
+	int previous = line_start;
+	for (int p = line_start; p < position; p = position_after(p)) previous = p;
+	return previous;
+}
+
+// A proportional font where narrow and wide letters differ a lot, so aligning by character counts
+// shows up as wrong. Zooming adds points to the size the same way it does in Scintilla.
+int FakeScintilla::text_width(int style, const char *s) const {
+	int width = 0;
+	for (const unsigned char *c = (const unsigned char *)s; *c; ++c) {
+		if (strchr("ijlt.,;:'|!", *c)) width += 3;
+		else if (strchr("mwMW@", *c)) width += 11;
+		else if (*c == ' ') width += 4;
+		else if (*c >= 'A' && *c <= 'Z') width += 8;
+		else if (*c < 0x80) width += 7;
+		else if (code_page != SC_CP_UTF8 || (*c & 0xC0) != 0x80) width += 12;
+	}
+
+	const int size = __max(FAKE_FONT_SIZE + zoom, 2);
+	return (width * size + FAKE_FONT_SIZE / 2) / FAKE_FONT_SIZE;
+}
+
+int FakeScintilla::max_first_visible_line() const {
+	return __max((int)line_starts.size() - lines_on_screen, 0);
+}
+
+// The per line data moves the same way as Scintilla's: new lines come after the line the edit started
+// on and lines that are removed take their data with them
+void FakeScintilla::shift_tabstops(int line, int linesAdded) {
+	if (linesAdded == 0 || (size_t)line + 1 >= tabstops.size()) return;
+
+	if (linesAdded > 0) tabstops.insert(tabstops.begin() + line + 1, linesAdded, std::vector<int>());
+	else tabstops.erase(tabstops.begin() + line + 1, tabstops.begin() + __min(line + 1 - linesAdded, (int)tabstops.size()));
+}
+
+// Scintilla keeps the same lines on screen when lines are inserted or deleted before them
+void FakeScintilla::edit(int position, const char *s, size_t insert_length, int delete_length) {
+	const int line = line_from_position(position);
+	const int line_count = (int)line_starts.size();
+	const bool above_view = position < position_from_line(first_visible_line);
+
+	text.replace((size_t)position, (size_t)delete_length, s, insert_length);
+	find_line_starts();
+
+	const int lines_added = (int)line_starts.size() - line_count;
+	shift_tabstops(line, lines_added);
+	if (above_view) first_visible_line += lines_added;
+	first_visible_line = __max(0, __min(first_visible_line, max_first_visible_line()));
+
+	// Positions after the edit move with the text
+	for (int *position_after_edit : { &anchor, &caret }) {
+		if (*position_after_edit > position + delete_length) *position_after_edit += (int)insert_length - delete_length;
+		else if (*position_after_edit > position) *position_after_edit = position;
+	}
+}
+
+void FakeScintilla::insert(int position, const char *s, size_t length) {
+	position = __max(0, __min(position, (int)text.size()));
+	if (length > 0) edit(position, s, length, 0);
+}
+
+void FakeScintilla::remove(int position, int length) {
+	position = __max(0, __min(position, (int)text.size()));
+	length = __min(length, (int)text.size() - position);
+	if (length > 0) edit(position, "", 0, length);
+}
+
+sptr_t FakeScintilla::message(unsigned int message, uptr_t wParam, sptr_t lParam) {
+	const char *s = reinterpret_cast<const char *>(lParam);
+
+	switch (message) {
+		case SCI_GETDIRECTFUNCTION: return reinterpret_cast<sptr_t>(DirectFunction);
+		case SCI_GETDIRECTPOINTER: return reinterpret_cast<sptr_t>(this);
+		case SCI_GETDOCPOINTER: return reinterpret_cast<sptr_t>(this);
+
+		// Text
+		case SCI_GETLENGTH:
+		case SCI_GETTEXTLENGTH: return (sptr_t)text.size();
+		case SCI_GETCHARACTERPOINTER: return reinterpret_cast<sptr_t>(text.c_str());
+		case SCI_GETRANGEPOINTER: return reinterpret_cast<sptr_t>(text.c_str() + __min((size_t)wParam, text.size()));
+		case SCI_GETCHARAT: return wParam < text.size() ? (char)text[wParam] : 0;
+		case SCI_GETTEXT:
+			if (lParam == 0) return (sptr_t)text.size();
+			if (wParam == 0) return 0;
+			{
+				const size_t length = __min((size_t)wParam - 1, text.size());
+				memcpy(reinterpret_cast<char *>(lParam), text.data(), length);
+				reinterpret_cast<char *>(lParam)[length] = '\0';
+				return (sptr_t)length;
+			}
+		case SCI_SETTEXT:
+			remove(0, (int)text.size());
+			anchor = caret = 0;
+			insert(0, s, strlen(s));
+			return 1;
+		case SCI_CLEARALL:
+			remove(0, (int)text.size());
+			anchor = caret = 0;
+			first_visible_line = 0;
+			return 0;
+		case SCI_APPENDTEXT: insert((int)text.size(), s, (size_t)wParam); return 0;
+		case SCI_INSERTTEXT: insert((int)wParam == -1 ? caret : (int)wParam, s, strlen(s)); return 0;
+		case SCI_DELETERANGE: remove((int)wParam, (int)lParam); return 0;
+		case SCI_SETTARGETRANGE: target_start = (int)wParam; target_end = (int)lParam; return 0;
+		case SCI_GETTARGETSTART: return target_start;
+		case SCI_GETTARGETEND: return target_end;
+		case SCI_REPLACETARGET: {
+			const size_t length = (int)wParam == -1 ? strlen(s) : (size_t)wParam;
+			remove(target_start, target_end - target_start);
+			insert(target_start, s, length);
+			target_end = target_start + (int)length;
+			return (sptr_t)length;
+		}
+		case SCI_COPYTEXT: clipboard.assign(s, (size_t)wParam); return 0;
+
+		// Lines and positions
+		case SCI_GETLINECOUNT: return (sptr_t)line_starts.size();
+		case SCI_LINEFROMPOSITION: return line_from_position(__max((int)wParam, 0));
+		case SCI_POSITIONFROMLINE:
+			if ((int)wParam > (int)line_starts.size()) return -1;
+			return position_from_line((int)wParam);
+		case SCI_GETLINEENDPOSITION: return line_end_position((int)wParam);
+		case SCI_POSITIONAFTER: return position_after((int)wParam);
+		case SCI_POSITIONBEFORE: return position_before((int)wParam);
+		case SCI_GETCODEPAGE: return code_page;
+		case SCI_SETCODEPAGE: code_page = (int)wParam; return 0;
+
+		// Selection, a single caret
+		case SCI_SETSEL:
+			caret = (int)lParam < 0 ? (int)text.size() : __min((int)lParam, (int)text.size());
+			anchor = (int)wParam < 0 ? caret : __min((int)wParam, (int)text.size());
+			return 0;
+		case SCI_GETSELECTIONSTART: return __min(anchor, caret);
+		case SCI_GETSELECTIONEND: return __max(anchor, caret);
+		case SCI_GETSELECTIONS: return 1;
+		case SCI_GETSELECTIONNCARET: return caret;
+		case SCI_GETSELECTIONNANCHOR: return anchor;
+		case SCI_GETCURRENTPOS: return caret;
+
+		// View
+		case SCI_GETFIRSTVISIBLELINE: return first_visible_line;
+		case SCI_SETFIRSTVISIBLELINE: first_visible_line = __max(0, __min((int)wParam, max_first_visible_line())); return 0;
+		case SCI_LINESONSCREEN: return lines_on_screen;
+		case SCI_GETZOOM: return zoom;
+		case SCI_SETZOOM: zoom = (int)wParam; return 0;
+		case SCI_GETTECHNOLOGY: return SC_TECHNOLOGY_DEFAULT;
+		case SCI_GETTABWIDTH: return 4;
+
+		// Styles, nothing is ever styled differently
+		case SCI_GETSTYLEAT: return 0;
+		case SCI_GETENDSTYLED: return (sptr_t)text.size();
+		case SCI_COLOURISE: return 0;
+		case SCI_TEXTWIDTH: return text_width((int)wParam, s);
+		case SCI_STYLEGETFONT:
+			if (lParam != 0) strcpy(reinterpret_cast<char *>(lParam), FAKE_FONT);
+			return (sptr_t)strlen(FAKE_FONT);
+		case SCI_STYLEGETSIZEFRACTIONAL: return FAKE_FONT_SIZE * SC_FONT_SIZE_MULTIPLIER;
+		case SCI_STYLEGETWEIGHT: return SC_WEIGHT_NORMAL;
+		case SCI_STYLEGETITALIC: return 0;
+		case SCI_STYLEGETCHARACTERSET: return SC_CHARSET_DEFAULT;
+		case SCI_GETMODEVENTMASK: return mod_event_mask;
+		case SCI_SETMODEVENTMASK: mod_event_mask = (int)wParam; return 0;
+
+		// Tabstops
+		case SCI_CLEARTABSTOPS:
+			if (wParam < tabstops.size()) tabstops[wParam].clear();
+			return 0;
+		case SCI_ADDTABSTOP: {
+			if ((int)wParam < 0 || (int)wParam >= (int)line_starts.size()) return 0;
+			if (wParam >= tabstops.size()) tabstops.resize(wParam + 1);
+			std::vector<int> &stops = tabstops[wParam];
+			auto it = std::lower_bound(stops.begin(), stops.end(), (int)lParam);
+			if (it == stops.end() || *it != (int)lParam) stops.insert(it, (int)lParam);
+			return 0;
+		}
+		case SCI_GETNEXTTABSTOP: {
+			if (wParam >= tabstops.size()) return 0;
+			const std::vector<int> &stops = tabstops[wParam];
+			auto it = std::upper_bound(stops.begin(), stops.end(), (int)lParam);
+			return it == stops.end() ? 0 : *it;
+		}
+
+		// Undo, markers, indicators and annotations are only shown, so there is nothing to keep
+		default: return 0;
+	}
+}
@@ -0,0 +1,79 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ScintillaEditor.h"
+
+// Just enough of Scintilla to run the engine without a window: the document, its lines, their
+// tabstops and a view of them. Text is measured with a made up proportional font and there is no
+// lexer, so everything is in the default style. Edits move the per line tabstops and the first
+// visible line the same way Scintilla does, which is what the engine relies on.
+class FakeScintilla final {
+private:
+	std::string text;
+	std::vector<int> line_starts;
+	std::vector<std::vector<int>> tabstops; // Per line, like Scintilla they stay with the line they were set on
+
+	int first_visible_line = 0;
+	int lines_on_screen;
+	int zoom = 0;
+	int code_page = SC_CP_UTF8;
+	int mod_event_mask = SC_MODEVENTMASKALL;
+	int target_start = 0;
+	int target_end = 0;
+	int anchor = 0;
+	int caret = 0;
+	std::string clipboard;
+
+	sptr_t message(unsigned int message, uptr_t wParam, sptr_t lParam);
+
+	void find_line_starts();
+	int line_from_position(int position) const;
+	int position_from_line(int line) const;
+	int line_end_position(int line) const;
+	int position_after(int position) const;
+	int position_before(int position) const;
+	int text_width(int style, const char *s) const;
+	int max_first_visible_line() const;
+
+	void shift_tabstops(int line, int linesAdded);
+	void edit(int position, const char *s, size_t insert_length, int delete_length);
+	void insert(int position, const char *s, size_t length);
+	void remove(int position, int length);
+
+public:
+	explicit FakeScintilla(int linesOnScreen = 50);
+
+	static sptr_t DirectFunction(sptr_t ptr, unsigned int message, uptr_t wParam, sptr_t lParam);
+
+	ScintillaEditor Editor() {
+		return ScintillaEditor(DirectFunction, (sptr_t)this);
+	}
+
+	// Messages sent to this window go to the fake
+	HWND Window() {
+		return (HWND)this;
+	}
+
+	const std::string &Clipboard() const {
+		return clipboard;
+	}
+};
@@ -0,0 +1,334 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <random>
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "ElasticTabstops.h"
+#include "FakeScintilla.h"
+#include "IncrementalCheck.h"
+#include "Recording.h"
+#include "Replay.h"
+
+// Runs the engine's debugging tools against a fake Scintilla, so they need neither Notepad++ nor
+// Windows. The exit code is 0 when everything passed.
+
+// The same defaults as the plugin
+static Configuration config = { true, {"*"}, 1, false, {".csv:,", ".psv:|", ".ssv:;"}, true, 256 * 1024 * 1024, 100000, 1000, 10000, 0, false, false };
+
+static int usage() {
+	fputs("Usage: ElasticTabstopsHeadless benchmark <baseline> [results]\n", stderr);
+	fputs("       ElasticTabstopsHeadless check [seed] [sequences]\n", stderr);
+	fputs("       ElasticTabstopsHeadless record <recording> [seed] [edits]\n", stderr);
+	fputs("       ElasticTabstopsHeadless replay <recording>\n", stderr);
+	return 2;
+}
+
+// src/BenchmarkBaseline.json is the results of this without the times, which are never compared
+static int benchmark(int argc, char *argv[]) {
+	if (argc < 3) return usage();
+
+	std::string baseline;
+	FILE *file = fopen(argv[2], "rb");
+	if (file != nullptr) {
+		char buffer[4096];
+		size_t length;
+		while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) baseline.append(buffer, length);
+		fclose(file);
+	}
+
+	const char *results = argc > 3 ? argv[3] : "ElasticTabstopsBenchmark.json";
+	std::wstring path(strlen(results), L'\0');
+	path.resize(mbstowcs(&path[0], results, path.size()));
+
+	FakeScintilla sci;
+	bool passed = false;
+	puts(BenchmarkRun(sci.Window(), &config, path, baseline, &passed).c_str());
+	return passed ? 0 : 1;
+}
+
+static int check(int argc, char *argv[]) {
+	const unsigned int seed = argc > 2 ? (unsigned int)strtoul(argv[2], nullptr, 10) : 1;
+	const int sequences = argc > 3 ? atoi(argv[3]) : 20;
+
+	FakeScintilla sci;
+	bool passed = false;
+	puts(IncrementalCheckRun(sci.Editor(), &config, seed, sequences, &passed).c_str());
+	return passed ? 0 : 1;
+}
+
+static void record_notification(FakeScintilla &sci, SCNotification *notify) {
+	notify->nmhdr.hwndFrom = sci.Window();
+	RecordingAdd(notify, sci.Window(), 0);
+}
+
+// Records random edits to a generated table the same way the plugin records a session, now and then
+// zooming. It doesn't scroll: scrolling measures blocks further than computing the same view from
+// scratch would, so the replayed view couldn't be compared with it.
+static int record(int argc, char *argv[]) {
+	if (argc < 3) return usage();
+
+	const unsigned int seed = argc > 3 ? (unsigned int)strtoul(argv[3], nullptr, 10) : 1;
+	const int edits = argc > 4 ? atoi(argv[4]) : 200;
+	static const char *insertions[] = { "x", "longer text", "\t", "a\tb", "\r\n", "x\t\r\n\t", "\t\t" };
+
+	std::wstring path(strlen(argv[2]), L'\0');
+	path.resize(mbstowcs(&path[0], argv[2], path.size()));
+
+	CorpusParams params = CorpusPresets[0];
+	params.seed = seed;
+	params.lines = 2000;
+
+	FakeScintilla sci;
+	const ScintillaEditor editor = sci.Editor();
+	editor.SetText(CorpusGenerate(&params));
+
+	std::mt19937 rng(seed);
+	editor.SetFirstVisibleLine((int)(rng() % editor.GetLineCount()));
+
+	RecordingStart(path, sci.Window(), 0);
+	if (!RecordingEnabled) {
+		fprintf(stderr, "%s could not be written\n", argv[2]);
+		return 2;
+	}
+
+	for (int i = 0; i < edits; ++i) {
+		SCNotification notify = {};
+
+		if (rng() % 250 == 0) {
+			editor.SetZoom((int)(rng() % 5) - 2);
+			notify.nmhdr.code = SCN_ZOOM;
+			record_notification(sci, &notify);
+			continue;
+		}
+
+		// Somewhere in the view the caret could be, so never between CR and LF
+		const int length = editor.GetLength();
+		const char *text = editor.GetCharacterPointer();
+		const int line = __min(editor.GetFirstVisibleLine() + (int)(rng() % editor.LinesOnScreen()), editor.GetLineCount() - 1);
+		const int line_start = editor.PositionFromLine(line);
+		int position = line_start + (int)(rng() % (editor.PositionFromLine(line + 1) - line_start + 1));
+		if (position > 0 && position < length && text[position - 1] == '\r' && text[position] == '\n') position--;
+
+		const int line_count = editor.GetLineCount();
+		std::string changed;
+		notify.nmhdr.code = SCN_MODIFIED;
+		if (rng() % 3 == 0) {
+			int delete_length = __min((int)(rng() % 5) + 1, length - position);
+			if (position + delete_length < length && text[position + delete_length - 1] == '\r' && text[position + delete_length] == '\n') delete_length++;
+			if (delete_length <= 0) continue;
+
+			changed.assign(text + position, delete_length);
+			editor.DeleteRange(position, delete_length);
+			notify.modificationType = SC_MOD_DELETETEXT | SC_PERFORMED_USER;
+		}
+		else {
+			changed = insertions[rng() % (sizeof(insertions) / sizeof(insertions[0]))];
+			editor.InsertText(position, changed);
+			notify.modificationType = SC_MOD_INSERTTEXT | SC_PERFORMED_USER;
+		}
+		notify.position = position;
+		notify.length = (Sci_Position)changed.size();
+		notify.linesAdded = editor.GetLineCount() - line_count;
+		notify.text = changed.data();
+		record_notification(sci, &notify);
+
+		notify = {};
+		notify.nmhdr.code = SCN_UPDATEUI;
+		notify.updated = SC_UPDATE_CONTENT;
+		record_notification(sci, &notify);
+	}
+
+	RecordingStop();
+	printf("Recorded %d edits of seed %u\n", edits, seed);
+	return 0;
+}
+
+static std::vector<std::vector<int>> get_view_tabstops(const ScintillaEditor &editor) {
+	std::vector<std::vector<int>> tabstops;
+	const int first_line = editor.GetFirstVisibleLine();
+	const int last_line = __min(first_line + editor.LinesOnScreen() + 1, editor.GetLineCount());
+
+	for (int line = first_line; line < last_line; ++line) {
+		std::vector<int> line_tabstops;
+		for (int x = editor.GetNextTabStop(line, 0); x > 0; x = editor.GetNextTabStop(line, x)) {
+			line_tabstops.push_back(x);
+		}
+		tabstops.push_back(line_tabstops);
+	}
+
+	return tabstops;
+}
+
+// Handles the notifications the same way beNotified does for the current view of an enabled file
+static void replay_notification(const ScintillaEditor &editor, SCNotification *notify, const RecordedNotification &recorded) {
+	static int numEdits = 0;
+	static bool recomputeView = false;
+	static bool inUndoRedo = false;
+	static struct {
+		int start;
+		int end;
+		int linesAdded;
+		bool hasSeparator;
+		int firstLine;
+		int lastLine;
+		bool withinLines;
+	} edit;
+
+	switch (recorded.code) {
+		case SCN_UPDATEUI:
+			if (notify->updated & SC_UPDATE_V_SCROLL || numEdits > 0 || recomputeView) {
+				if (recomputeView) {
+					ElasticTabstopsComputeCurrentView();
+				}
+				else if (numEdits == 1) {
+					ElasticTabstopsOnModify(edit.start, edit.end, edit.linesAdded, edit.hasSeparator);
+				}
+				else if (numEdits > 1 && edit.withinLines) {
+					ElasticTabstopsOnModifyColumn(edit.firstLine, edit.lastLine, numEdits);
+				}
+				else if (numEdits == 0) {
+					ElasticTabstopsOnScroll();
+				}
+				else {
+					ElasticTabstopsComputeCurrentView();
+				}
+
+				numEdits = 0;
+				recomputeView = false;
+			}
+			else {
+				ElasticTabstopsComputeRestyled();
+			}
+			break;
+		case SCN_MODIFIED: {
+			const bool isInsert = (notify->modificationType & SC_MOD_INSERTTEXT) != 0;
+			const bool isDelete = (notify->modificationType & SC_MOD_DELETETEXT) != 0;
+			if (!isInsert && !isDelete && !inUndoRedo) break;
+
+			if (isInsert || isDelete) {
+				if ((notify->modificationType & SC_MULTISTEPUNDOREDO) && !inUndoRedo) {
+					inUndoRedo = true;
+					ElasticTabstopsBeginLinesChanged();
+				}
+
+				ElasticTabstopsOnLinesChanged(static_cast<int>(notify->position), static_cast<int>(notify->linesAdded));
+			}
+
+			if (inUndoRedo) {
+				if (notify->modificationType & SC_LASTSTEPINUNDOREDO) {
+					inUndoRedo = false;
+					ElasticTabstopsEndLinesChanged();
+					recomputeView = true;
+				}
+			}
+			else if (isInsert || isDelete) {
+				const bool hasSeparator = notify->text && memchr(notify->text, '\t', notify->length) != NULL;
+				const int line = editor.LineFromPosition(static_cast<int>(notify->position));
+
+				numEdits++;
+				if (numEdits == 1) {
+					edit.start = static_cast<int>(notify->position);
+					edit.end = static_cast<int>(isInsert ? notify->position + notify->length : notify->position);
+					edit.linesAdded = static_cast<int>(notify->linesAdded);
+					edit.hasSeparator = hasSeparator;
+					edit.firstLine = line;
+					edit.lastLine = line;
+					edit.withinLines = true;
+				}
+				else {
+					edit.firstLine = __min(edit.firstLine, line);
+					edit.lastLine = __max(edit.lastLine, line);
+				}
+				edit.withinLines = edit.withinLines && notify->linesAdded == 0 && !hasSeparator;
+			}
+			break;
+		}
+		case SCN_ZOOM:
+			// Nothing notifies the fake's zoom, so it is changed here
+			editor.SetZoom(recorded.zoom);
+			ElasticTabstopsSwitchToEditor(editor, &config);
+			ElasticTabstopsComputeCurrentView();
+			break;
+		case REPLAY_LANGCHANGED:
+			ElasticTabstopsDropWidths();
+			ElasticTabstopsSwitchToEditor(editor, &config);
+			ElasticTabstopsComputeCurrentView();
+			break;
+		case REPLAY_BUFFERACTIVATED:
+			numEdits = 0;
+			recomputeView = false;
+			inUndoRedo = false;
+			ElasticTabstopsSwitchToEditor(editor, &config);
+			ElasticTabstopsComputeCurrentView();
+			break;
+	}
+}
+
+// Replays a recording made by the plugin, then checks the view ended up the same as computing it from scratch
+static int replay(int argc, char *argv[]) {
+	if (argc < 3) return usage();
+
+	FILE *file = fopen(argv[2], "rb");
+	if (file == nullptr) {
+		fprintf(stderr, "%s could not be opened\n", argv[2]);
+		return 2;
+	}
+
+	std::vector<RecordedNotification> notifications;
+	const bool valid = ReplayLoad(file, notifications);
+	fclose(file);
+	if (!valid) {
+		fprintf(stderr, "%s is not a recording\n", argv[2]);
+		return 2;
+	}
+
+	FakeScintilla sci;
+	const ScintillaEditor editor = sci.Editor();
+	ElasticTabstopsSetSeparator('\t', false);
+
+	puts(ReplayRun(editor, notifications, [&sci, &editor](SCNotification *notify, const RecordedNotification &recorded) {
+		notify->nmhdr.hwndFrom = sci.Window();
+		replay_notification(editor, notify, recorded);
+	}).c_str());
+
+	const std::vector<std::vector<int>> replayed = get_view_tabstops(editor);
+	ElasticTabstopsClearTabstops();
+	ElasticTabstopsComputeCurrentView();
+	if (get_view_tabstops(editor) != replayed) {
+		puts("FAILED the replayed view differs from computing it from scratch");
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	setlocale(LC_CTYPE, "");
+
+	if (argc < 2) return usage();
+	if (strcmp(argv[1], "benchmark") == 0) return benchmark(argc, argv);
+	if (strcmp(argv[1], "check") == 0) return check(argc, argv);
+	if (strcmp(argv[1], "record") == 0) return record(argc, argv);
+	if (strcmp(argv[1], "replay") == 0) return replay(argc, argv);
+	return usage();
+}
@@ -0,0 +1,104 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <chrono>
+#include <string>
+#include "windows.h"
+#include "FakeScintilla.h"
+
+// Every window is a fake Scintilla
+LRESULT SendMessage(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam) {
+	return FakeScintilla::DirectFunction(reinterpret_cast<sptr_t>(hWnd), Msg, wParam, lParam);
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER *lpPerformanceCount) {
+	lpPerformanceCount->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *lpFrequency) {
+	lpFrequency->QuadPart = 1000000000;
+	return TRUE;
+}
+
+// The lead bytes of the double byte code pages Scintilla supports
+BOOL IsDBCSLeadByteEx(UINT CodePage, BYTE TestChar) {
+	switch (CodePage) {
+		case 932: return (TestChar >= 0x81 && TestChar <= 0x9F) || (TestChar >= 0xE0 && TestChar <= 0xFC);
+		case 936:
+		case 949:
+		case 950: return TestChar >= 0x81 && TestChar <= 0xFE;
+		case 1361: return (TestChar >= 0x84 && TestChar <= 0xD3) || (TestChar >= 0xD8 && TestChar <= 0xDE) || (TestChar >= 0xE0 && TestChar <= 0xF9);
+		default: return FALSE;
+	}
+}
+
+static std::string to_utf8(const wchar_t *text) {
+	std::string utf8;
+	for (; *text; ++text) {
+		const uint32_t c = (uint32_t)*text;
+		if (c < 0x80) {
+			utf8 += (char)c;
+		}
+		else if (c < 0x800) {
+			utf8 += (char)(0xC0 | (c >> 6));
+			utf8 += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000) {
+			utf8 += (char)(0xE0 | (c >> 12));
+			utf8 += (char)(0x80 | ((c >> 6) & 0x3F));
+			utf8 += (char)(0x80 | (c & 0x3F));
+		}
+		else {
+			utf8 += (char)(0xF0 | (c >> 18));
+			utf8 += (char)(0x80 | ((c >> 12) & 0x3F));
+			utf8 += (char)(0x80 | ((c >> 6) & 0x3F));
+			utf8 += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return utf8;
+}
+
+FILE *_wfopen(const wchar_t *filename, const wchar_t *mode) {
+	return fopen(to_utf8(filename).c_str(), to_utf8(mode).c_str());
+}
+
+// Snapshots only save measuring, without them the layout is always measured
+HANDLE CreateFileW(const wchar_t *, DWORD, DWORD, void *, DWORD, DWORD, HANDLE) {
+	return INVALID_HANDLE_VALUE;
+}
+
+BOOL GetFileSizeEx(HANDLE, LARGE_INTEGER *) {
+	return FALSE;
+}
+
+HANDLE CreateFileMappingW(HANDLE, void *, DWORD, DWORD, DWORD, const wchar_t *) {
+	return nullptr;
+}
+
+void *MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, size_t) {
+	return nullptr;
+}
+
+BOOL UnmapViewOfFile(const void *) {
+	return FALSE;
+}
+
+BOOL CloseHandle(HANDLE) {
+	return FALSE;
+}
@@ -0,0 +1,92 @@
+// This file is part of ElasticTabstops.
+// 
+// Copyright (C)2016 Justin Dailey <dail8859@yahoo.com>
+// 
+// ElasticTabstops is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#pragma once
+
+// Just the parts of the Windows API the engine and its debugging tools use, so they build on other
+// platforms. Windows are fake Scintillas, see FakeScintilla.h, and snapshots can't be mapped.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+typedef void *HWND;
+typedef void *HANDLE;
+typedef void *HMODULE;
+typedef void *HINSTANCE;
+typedef void *HMENU;
+typedef void *HBITMAP;
+typedef void *HICON;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned char UCHAR;
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef intptr_t LRESULT;
+typedef uintptr_t UINT_PTR;
+
+typedef union _LARGE_INTEGER {
+	int64_t QuadPart;
+} LARGE_INTEGER;
+
+typedef struct tagNMHDR {
+	HWND hwndFrom;
+	UINT_PTR idFrom;
+	UINT code;
+} NMHDR;
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define WM_USER 0x0400
+
+#define WINAPI
+#define CALLBACK
+#define __cdecl
+#define __stdcall
+#define __declspec(attribute)
+
+#define __max(a, b) (((a) > (b)) ? (a) : (b))
+#define __min(a, b) (((a) < (b)) ? (a) : (b))
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define GENERIC_READ 0x80000000
+#define FILE_SHARE_READ 0x00000001
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define PAGE_READONLY 0x02
+#define FILE_MAP_READ 0x0004
+
+LRESULT SendMessage(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam);
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER *lpPerformanceCount);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *lpFrequency);
+
+BOOL IsDBCSLeadByteEx(UINT CodePage, BYTE TestChar);
+
+FILE *_wfopen(const wchar_t *filename, const wchar_t *mode);
+
+HANDLE CreateFileW(const wchar_t *lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, void *lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER *lpFileSize);
+HANDLE CreateFileMappingW(HANDLE hFile, void *lpFileMappingAttributes, DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, const wchar_t *lpName);
+void *MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess, DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, size_t dwNumberOfBytesToMap);
+BOOL UnmapViewOfFile(const void *lpBaseAddress);
+BOOL CloseHandle(HANDLE hObject);